@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+// per-instance bump allocator for audio thread state
+// sized and pre-faulted on message thread (prepareToPlay), carved out on the
+// same thread, never grown or freed while audio is running
+class AudioArena
+{
+  public:
+    static constexpr std::size_t alignment = 64;
+
+    // round up to alignment so every carved block starts on a cache line
+    template <typename T>
+    static constexpr std::size_t bytesFor(std::size_t n)
+    {
+        return (n * sizeof(T) + alignment - 1) & ~(alignment - 1);
+    }
+
+    // drops previous carve-outs, reallocates only if capacity is too small
+    void reserve(std::size_t bytes)
+    {
+        used = 0;
+
+        if (bytes > capacity)
+        {
+            storage.reset(new char[bytes + alignment]);
+            capacity = bytes;
+        }
+
+        auto p = reinterpret_cast<std::uintptr_t>(storage.get());
+        base = storage.get() + ((alignment - (p & (alignment - 1))) &
+                                (alignment - 1));
+
+        // touch every page now, not on first audio callback
+        if (base != nullptr)
+            std::memset(base, 0, capacity);
+    }
+
+    // returns zeroed storage for n elements, nullptr if arena is exhausted
+    template <typename T>
+    T* allocate(std::size_t n)
+    {
+        auto bytes = bytesFor<T>(n);
+        if (base == nullptr || used + bytes > capacity)
+            return nullptr;
+
+        auto p = base + used;
+        used += bytes;
+        return reinterpret_cast<T*>(p);
+    }
+
+    std::size_t getCapacity() const
+    {
+        return capacity;
+    }
+
+    std::size_t getUsed() const
+    {
+        return used;
+    }
+
+  private:
+    std::unique_ptr<char[]> storage{};
+    char* base = nullptr;
+    std::size_t capacity = 0;
+    std::size_t used = 0;
+};
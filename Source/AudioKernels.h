@@ -0,0 +1,344 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define NDI_AUDIO_IO_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define NDI_AUDIO_IO_NEON 1
+#endif
+
+// copy kernels with peak and sum of squares fused into the same pass, plus
+// scaled copy and multiply-accumulate for the send matrix and channel gains.
+// Gains ramp linearly across the block for smoothing.
+// converts between host sample type and NDI float, 8 samples per iteration
+// on SSE2/NEON, scalar tail and fallback elsewhere
+namespace AudioKernels
+{
+struct Levels
+{
+    float peak = 0.0f;
+    float sum_squares = 0.0f;
+};
+
+// gain of sample i is start + step * i
+struct Ramp
+{
+    float start = 1.0f;
+    float step = 0.0f;
+
+    bool isUnity() const
+    {
+        return start == 1.0f && step == 0.0f;
+    }
+};
+
+namespace detail
+{
+#if NDI_AUDIO_IO_SSE2
+using Vec = __m128;
+
+inline Vec zero()
+{
+    return _mm_setzero_ps();
+}
+
+inline Vec set(float x)
+{
+    return _mm_set1_ps(x);
+}
+
+inline Vec mul(Vec a, Vec b)
+{
+    return _mm_mul_ps(a, b);
+}
+
+inline Vec add(Vec a, Vec b)
+{
+    return _mm_add_ps(a, b);
+}
+
+inline Vec fmadd(Vec acc, Vec a, Vec b)
+{
+    return _mm_add_ps(acc, _mm_mul_ps(a, b));
+}
+
+inline Vec load(const float *p)
+{
+    return _mm_loadu_ps(p);
+}
+
+inline Vec load(const double *p)
+{
+    return _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(p)),
+                         _mm_cvtpd_ps(_mm_loadu_pd(p + 2)));
+}
+
+inline void store(float *p, Vec v)
+{
+    _mm_storeu_ps(p, v);
+}
+
+inline void store(double *p, Vec v)
+{
+    _mm_storeu_pd(p, _mm_cvtps_pd(v));
+    _mm_storeu_pd(p + 2, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+}
+
+inline Vec abs(Vec v)
+{
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+}
+
+inline Vec max(Vec a, Vec b)
+{
+    return _mm_max_ps(a, b);
+}
+
+inline Vec madd(Vec acc, Vec a)
+{
+    return _mm_add_ps(acc, _mm_mul_ps(a, a));
+}
+
+inline float hmax(Vec v)
+{
+    v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+inline float hsum(Vec v)
+{
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+#elif NDI_AUDIO_IO_NEON
+using Vec = float32x4_t;
+
+inline Vec zero()
+{
+    return vdupq_n_f32(0.0f);
+}
+
+inline Vec set(float x)
+{
+    return vdupq_n_f32(x);
+}
+
+inline Vec mul(Vec a, Vec b)
+{
+    return vmulq_f32(a, b);
+}
+
+inline Vec add(Vec a, Vec b)
+{
+    return vaddq_f32(a, b);
+}
+
+inline Vec fmadd(Vec acc, Vec a, Vec b)
+{
+    return vfmaq_f32(acc, a, b);
+}
+
+inline Vec load(const float *p)
+{
+    return vld1q_f32(p);
+}
+
+inline Vec load(const double *p)
+{
+    return vcombine_f32(vcvt_f32_f64(vld1q_f64(p)),
+                        vcvt_f32_f64(vld1q_f64(p + 2)));
+}
+
+inline void store(float *p, Vec v)
+{
+    vst1q_f32(p, v);
+}
+
+inline void store(double *p, Vec v)
+{
+    vst1q_f64(p, vcvt_f64_f32(vget_low_f32(v)));
+    vst1q_f64(p + 2, vcvt_high_f64_f32(v));
+}
+
+inline Vec abs(Vec v)
+{
+    return vabsq_f32(v);
+}
+
+inline Vec max(Vec a, Vec b)
+{
+    return vmaxq_f32(a, b);
+}
+
+inline Vec madd(Vec acc, Vec a)
+{
+    return vfmaq_f32(acc, a, a);
+}
+
+inline float hmax(Vec v)
+{
+    return vmaxvq_f32(v);
+}
+
+inline float hsum(Vec v)
+{
+    return vaddvq_f32(v);
+}
+#endif
+
+// gains of 4 consecutive samples
+inline Vec ramp(float start, float step)
+{
+    const float g[4] = {start, start + step, start + 2.0f * step,
+                        start + 3.0f * step};
+    return load(g);
+}
+
+template <bool Store, bool Scale, typename Src, typename Dst>
+Levels process(const Src *src, Dst *dst, int n, Ramp gain)
+{
+    Levels levels{};
+    auto i = 0;
+
+#if NDI_AUDIO_IO_SSE2 || NDI_AUDIO_IO_NEON
+    // two independent accumulators hide add latency
+    auto peak0 = zero(), peak1 = zero();
+    auto sum0 = zero(), sum1 = zero();
+    auto ga = ramp(gain.start, gain.step);
+    auto gb = ramp(gain.start + 4.0f * gain.step, gain.step);
+    const auto g8 = set(8.0f * gain.step);
+    for (; i + 8 <= n; i += 8)
+    {
+        auto a = load(src + i);
+        auto b = load(src + i + 4);
+        if constexpr (Scale)
+        {
+            a = mul(a, ga);
+            b = mul(b, gb);
+            ga = add(ga, g8);
+            gb = add(gb, g8);
+        }
+        if constexpr (Store)
+        {
+            store(dst + i, a);
+            store(dst + i + 4, b);
+        }
+        peak0 = max(peak0, abs(a));
+        peak1 = max(peak1, abs(b));
+        sum0 = madd(sum0, a);
+        sum1 = madd(sum1, b);
+    }
+    levels.peak = hmax(max(peak0, peak1));
+    levels.sum_squares = hsum(sum0) + hsum(sum1);
+#endif
+
+    for (; i < n; i++)
+    {
+        auto x = static_cast<float>(src[i]);
+        if constexpr (Scale)
+            x *= gain.start + gain.step * (float)i;
+        if constexpr (Store)
+            dst[i] = static_cast<Dst>(x);
+        levels.peak = std::max(levels.peak, std::abs(x));
+        levels.sum_squares += x * x;
+    }
+
+    return levels;
+}
+} // namespace detail
+
+// dst = src converted to Dst, levels measured on the converted samples
+template <typename Src, typename Dst>
+Levels copyMeasure(const Src *src, Dst *dst, int n)
+{
+    return detail::process<true, false>(src, dst, n, Ramp{});
+}
+
+// dst = gain * src, levels measured on the result
+template <typename Src>
+Levels copyScaleMeasure(const Src *src, float *dst, float gain, int n)
+{
+    return detail::process<true, true>(src, dst, n, Ramp{gain, 0.0f});
+}
+
+// dst = ramped gain * src in the same pass, plain copy at unity
+template <typename Src, typename Dst>
+Levels copyGainMeasure(const Src *src, Dst *dst, int n, Ramp gain)
+{
+    if (gain.isUnity())
+        return detail::process<true, false>(src, dst, n, gain);
+    return detail::process<true, true>(src, dst, n, gain);
+}
+
+// dst = src_n samples of src stretched or squeezed to n by linear
+// interpolation, first and last sample kept so blocks join without a step.
+// Silence if src is empty. For sample-slip of a few samples, scalar.
+template <typename Dst>
+Levels stretchMeasure(const float *src, int src_n, Dst *dst, int n,
+                      Ramp gain = {})
+{
+    Levels levels{};
+    if (src_n < 1)
+    {
+        std::fill(dst, dst + std::max(n, 0), Dst{});
+        return levels;
+    }
+
+    const auto step = n > 1 ? (double)(src_n - 1) / (double)(n - 1) : 0.0;
+    for (auto i = 0; i < n; i++)
+    {
+        auto pos = i * step;
+        auto k = std::min((int)pos, src_n - 1);
+        auto frac = (float)(pos - k);
+        auto x = k + 1 < src_n ? src[k] + (src[k + 1] - src[k]) * frac
+                               : src[k];
+        x *= gain.start + gain.step * (float)i;
+        dst[i] = static_cast<Dst>(x);
+        levels.peak = std::max(levels.peak, std::abs(x));
+        levels.sum_squares += x * x;
+    }
+    return levels;
+}
+
+// levels only, no copy, measured as if gain was applied
+template <typename Src>
+Levels measure(const Src *src, int n, Ramp gain = {})
+{
+    if (gain.isUnity())
+        return detail::process<false, false, Src, float>(src, nullptr, n,
+                                                         gain);
+    return detail::process<false, true, Src, float>(src, nullptr, n, gain);
+}
+
+// dst += ramped gain * src
+template <typename Src>
+void multiplyAdd(const Src *src, float *dst, Ramp gain, int n)
+{
+    auto i = 0;
+
+#if NDI_AUDIO_IO_SSE2 || NDI_AUDIO_IO_NEON
+    auto ga = detail::ramp(gain.start, gain.step);
+    auto gb = detail::ramp(gain.start + 4.0f * gain.step, gain.step);
+    const auto g8 = detail::set(8.0f * gain.step);
+    for (; i + 8 <= n; i += 8)
+    {
+        detail::store(dst + i, detail::fmadd(detail::load(dst + i),
+                                             detail::load(src + i), ga));
+        detail::store(dst + i + 4,
+                      detail::fmadd(detail::load(dst + i + 4),
+                                    detail::load(src + i + 4), gb));
+        ga = detail::add(ga, g8);
+        gb = detail::add(gb, g8);
+    }
+#endif
+
+    for (; i < n; i++)
+        dst[i] += (gain.start + gain.step * (float)i) *
+                  static_cast<float>(src[i]);
+}
+} // namespace AudioKernels
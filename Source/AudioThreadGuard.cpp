@@ -0,0 +1,288 @@
+#include "AudioThreadGuard.h"
+
+#if NDI_AUDIO_IO_AUDIO_THREAD_GUARD
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+namespace
+{
+// initial-exec keeps TLS access itself from calling malloc
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((tls_model("initial-exec")))
+#endif
+thread_local int guard_depth = 0;
+
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((tls_model("initial-exec")))
+#endif
+thread_local int suspend_depth = 0;
+
+std::atomic<AudioThreadGuard::Handler> handler{nullptr};
+} // namespace
+
+namespace AudioThreadGuard
+{
+void check(const char* what) noexcept
+{
+    if (guard_depth == 0 || suspend_depth > 0)
+        return;
+
+    // no allocation from here on
+    suspend_depth++;
+    if (auto h = handler.load())
+    {
+        h(what);
+        suspend_depth--;
+        return;
+    }
+
+    std::fputs("NDI Audio IO: audio thread violation in processBlock2: ",
+               stderr);
+    std::fputs(what, stderr);
+    std::fputs("\n", stderr);
+    std::fflush(stderr);
+    std::abort();
+}
+
+void setHandler(Handler h) noexcept
+{
+    handler = h;
+}
+
+Scope::Scope() noexcept
+{
+    guard_depth++;
+}
+
+Scope::~Scope()
+{
+    guard_depth--;
+}
+
+Suspend::Suspend() noexcept
+{
+    suspend_depth++;
+}
+
+Suspend::~Suspend()
+{
+    suspend_depth--;
+}
+} // namespace AudioThreadGuard
+
+//==============================================================================
+// allocation hooks
+
+#if defined(__GLIBC__)
+extern "C"
+{
+    void* __libc_malloc(size_t);
+    void* __libc_calloc(size_t, size_t);
+    void* __libc_realloc(void*, size_t);
+    void* __libc_memalign(size_t, size_t);
+    void __libc_free(void*);
+
+    void* malloc(size_t n)
+    {
+        AudioThreadGuard::check("malloc");
+        return __libc_malloc(n);
+    }
+
+    void* calloc(size_t n, size_t size)
+    {
+        AudioThreadGuard::check("calloc");
+        return __libc_calloc(n, size);
+    }
+
+    void* realloc(void* p, size_t n)
+    {
+        AudioThreadGuard::check("realloc");
+        return __libc_realloc(p, n);
+    }
+
+    void free(void* p)
+    {
+        if (p != nullptr)
+            AudioThreadGuard::check("free");
+        __libc_free(p);
+    }
+
+    void* memalign(size_t alignment, size_t n)
+    {
+        AudioThreadGuard::check("memalign");
+        return __libc_memalign(alignment, n);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t n)
+    {
+        AudioThreadGuard::check("aligned_alloc");
+        return __libc_memalign(alignment, n);
+    }
+
+    int posix_memalign(void** p, size_t alignment, size_t n)
+    {
+        AudioThreadGuard::check("posix_memalign");
+        if (alignment % sizeof(void*) != 0 ||
+            (alignment & (alignment - 1)) != 0)
+            return EINVAL;
+        auto q = __libc_memalign(alignment, n);
+        if (q == nullptr)
+            return ENOMEM;
+        *p = q;
+        return 0;
+    }
+}
+#endif
+
+namespace
+{
+// storage for aligned operator new, nullptr if out of memory
+void* alignedAlloc(std::size_t n, std::align_val_t alignment) noexcept
+{
+    auto a = static_cast<std::size_t>(alignment);
+#if defined(_WIN32)
+    return _aligned_malloc(n ? n : 1, a);
+#else
+    void* p = nullptr;
+    if (a < sizeof(void*))
+        a = sizeof(void*);
+    return posix_memalign(&p, a, n ? n : 1) == 0 ? p : nullptr;
+#endif
+}
+
+void alignedFree(void* p) noexcept
+{
+#if defined(_WIN32)
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+} // namespace
+
+void* operator new(std::size_t n)
+{
+    AudioThreadGuard::check("operator new");
+    if (auto p = std::malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t n)
+{
+    AudioThreadGuard::check("operator new[]");
+    if (auto p = std::malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept
+{
+    AudioThreadGuard::check("operator new");
+    return std::malloc(n ? n : 1);
+}
+
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept
+{
+    AudioThreadGuard::check("operator new[]");
+    return std::malloc(n ? n : 1);
+}
+
+void operator delete(void* p) noexcept
+{
+    if (p != nullptr)
+        AudioThreadGuard::check("operator delete");
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    if (p != nullptr)
+        AudioThreadGuard::check("operator delete[]");
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    operator delete[](p);
+}
+
+void* operator new(std::size_t n, std::align_val_t alignment)
+{
+    AudioThreadGuard::check("operator new");
+    if (auto p = alignedAlloc(n, alignment))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t n, std::align_val_t alignment)
+{
+    AudioThreadGuard::check("operator new[]");
+    if (auto p = alignedAlloc(n, alignment))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t n, std::align_val_t alignment,
+                   const std::nothrow_t&) noexcept
+{
+    AudioThreadGuard::check("operator new");
+    return alignedAlloc(n, alignment);
+}
+
+void* operator new[](std::size_t n, std::align_val_t alignment,
+                     const std::nothrow_t&) noexcept
+{
+    AudioThreadGuard::check("operator new[]");
+    return alignedAlloc(n, alignment);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    if (p != nullptr)
+        AudioThreadGuard::check("operator delete");
+    alignedFree(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+    if (p != nullptr)
+        AudioThreadGuard::check("operator delete[]");
+    alignedFree(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(p, alignment);
+}
+
+void operator delete[](void* p, std::size_t,
+                       std::align_val_t alignment) noexcept
+{
+    operator delete[](p, alignment);
+}
+
+void operator delete(void* p, std::align_val_t alignment,
+                     const std::nothrow_t&) noexcept
+{
+    operator delete(p, alignment);
+}
+
+void operator delete[](void* p, std::align_val_t alignment,
+                       const std::nothrow_t&) noexcept
+{
+    operator delete[](p, alignment);
+}
+#endif
@@ -0,0 +1,106 @@
+#pragma once
+#include <mutex>
+
+// Debug/test mode that aborts when the audio thread allocates or takes a
+// mutex while inside processBlock2. Build with
+// -DNDI_AUDIO_IO_AUDIO_THREAD_GUARD=ON. Compiles to nothing otherwise.
+//
+// NDI SDK calls are external and may allocate internally, wrap them in
+// AudioThreadGuard::Suspend so only our own code is checked.
+//
+// Mutex and Lock<juce::SpinLock> or Lock<juce::CriticalSection> check their
+// blocking lock, tryEnter stays allowed as the audio thread takes audio_lock
+// that way.
+//
+// Global operator new/delete, their aligned forms and (on glibc) malloc
+// family with memalign, aligned_alloc and posix_memalign are replaced in
+// AudioThreadGuard.cpp. In plugin formats the host may resolve these symbols
+// first, the Standalone target is the reliable place to run the checks.
+namespace AudioThreadGuard
+{
+#if NDI_AUDIO_IO_AUDIO_THREAD_GUARD
+// abort with message if calling thread is inside a guarded scope
+void check(const char* what) noexcept;
+
+// called instead of abort, for unit checks. Must not allocate, nullptr
+// restores abort.
+using Handler = void (*)(const char* what) noexcept;
+void setHandler(Handler h) noexcept;
+
+// marks calling thread as audio thread for the scope lifetime
+struct Scope
+{
+    Scope() noexcept;
+    ~Scope();
+};
+
+// temporarily lifts checks, e.g. around NDI SDK calls
+struct Suspend
+{
+    Suspend() noexcept;
+    ~Suspend();
+};
+
+// std::mutex that must never be locked from a guarded scope
+class Mutex
+{
+  public:
+    void lock()
+    {
+        check("mutex lock");
+        m.lock();
+    }
+
+    bool try_lock()
+    {
+        check("mutex try_lock");
+        return m.try_lock();
+    }
+
+    void unlock()
+    {
+        m.unlock();
+    }
+
+  private:
+    std::mutex m;
+};
+
+// lock with enter/exit/tryEnter whose enter must never block a guarded
+// scope, e.g. Lock<juce::SpinLock>. Use GenericScopedLock<decltype(l)>, the
+// ScopedLockType of the base class does not see the check.
+template <typename L>
+class Lock : public L
+{
+  public:
+    void enter() const noexcept
+    {
+        check("lock enter");
+        L::enter();
+    }
+};
+#else
+inline void check(const char*) noexcept
+{
+}
+
+struct Scope
+{
+    Scope() noexcept
+    {
+    }
+};
+
+struct Suspend
+{
+    Suspend() noexcept
+    {
+    }
+};
+
+using Mutex = std::mutex;
+
+template <typename L>
+using Lock = L;
+#endif
+} // namespace AudioThreadGuard
@@ -0,0 +1,168 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// per-channel activity bitmap, carried in NDI metadata frames as
+// <ndi_audio_activity channels="64" mask="..."/>
+// mask is hex, one digit per 4 channels in channel order, bit 0 of a digit is
+// its first channel. Receivers that do not know the element ignore it.
+//
+// Metadata is not queued with the audio in the frame-sync, a bitmap applies
+// to audio that is still up to the queue depth away. The audio thread turns
+// a channel active as soon as the bitmap says so and inactive only once the
+// bitmap has said so for longer than the queue depth.
+class ChannelActivity
+{
+  public:
+    static constexpr int max_channels = 256;
+    static constexpr int num_words = max_channels / 64;
+    static constexpr auto tag = "<ndi_audio_activity";
+
+    using Mask = std::array<uint64_t, num_words>;
+
+    // writes metadata element into dst, returns false if it does not fit
+    static bool format(char *dst, std::size_t size, const Mask &mask,
+                       int channels)
+    {
+        static constexpr char hex[] = "0123456789abcdef";
+
+        channels = channels < 0 ? 0
+                   : channels > max_channels ? max_channels
+                                             : channels;
+        auto digits = (channels + 3) / 4;
+
+        // tag, channels="nnn", mask="", />, terminator
+        if (size < std::strlen(tag) + 16 + 8 + (std::size_t)digits + 4)
+            return false;
+
+        auto p = dst;
+        for (auto t = tag; *t;)
+            *p++ = *t++;
+        for (auto t = " channels=\""; *t;)
+            *p++ = *t++;
+        if (channels >= 100)
+            *p++ = (char)('0' + channels / 100);
+        if (channels >= 10)
+            *p++ = (char)('0' + channels / 10 % 10);
+        *p++ = (char)('0' + channels % 10);
+        for (auto t = "\" mask=\""; *t;)
+            *p++ = *t++;
+        for (auto i = 0; i < digits; i++)
+        {
+            auto bits = (mask[(size_t)(i / 16)] >> ((i % 16) * 4)) & 0xf;
+            *p++ = hex[bits];
+        }
+        for (auto t = "\"/>"; *t;)
+            *p++ = *t++;
+        *p = '\0';
+        return true;
+    }
+
+    // parses metadata element, returns false if xml is not one
+    static bool parse(const char *xml, Mask &mask, int &channels)
+    {
+        if (xml == nullptr || std::strstr(xml, tag) == nullptr)
+            return false;
+
+        auto c = std::strstr(xml, "channels=\"");
+        auto m = std::strstr(xml, "mask=\"");
+        if (c == nullptr || m == nullptr)
+            return false;
+
+        channels = 0;
+        for (c += 10; *c >= '0' && *c <= '9'; c++)
+            channels = channels * 10 + (*c - '0');
+        if (channels > max_channels)
+            channels = max_channels;
+
+        mask.fill(0);
+        m += 6;
+        for (auto i = 0; i < (channels + 3) / 4 && m[i] != '"'; i++)
+        {
+            auto d = m[i];
+            uint64_t bits = d >= '0' && d <= '9'   ? (uint64_t)(d - '0')
+                            : d >= 'a' && d <= 'f' ? (uint64_t)(d - 'a' + 10)
+                            : d >= 'A' && d <= 'F' ? (uint64_t)(d - 'A' + 10)
+                                                   : 0xf;
+            mask[(size_t)(i / 16)] |= bits << ((i % 16) * 4);
+        }
+        return true;
+    }
+
+    // writer side, worker thread
+    void store(const Mask &mask)
+    {
+        for (std::size_t i = 0; i < num_words; i++)
+            words[i].store(mask[i], std::memory_order_relaxed);
+        valid.store(true, std::memory_order_release);
+    }
+
+    // unknown, every channel counts as active. Under the lock that keeps
+    // the audio thread out.
+    void reset()
+    {
+        valid.store(false, std::memory_order_release);
+        seen = allActive();
+        applied = allActive();
+        stable = 0;
+    }
+
+    // true once a bitmap arrived since reset, any thread
+    bool isValid() const
+    {
+        return valid.load(std::memory_order_acquire);
+    }
+
+    // reader side, audio thread, once per block before isActive with the
+    // samples queued ahead of it
+    void follow(int depth, int numSamples)
+    {
+        auto mask = allActive();
+        if (valid.load(std::memory_order_acquire))
+            for (std::size_t i = 0; i < num_words; i++)
+                mask[i] = words[i].load(std::memory_order_relaxed);
+
+        if (mask != seen)
+        {
+            seen = mask;
+            stable = 0;
+            for (std::size_t i = 0; i < num_words; i++)
+                applied[i] |= mask[i];
+            return;
+        }
+
+        if (stable <= depth)
+            stable += numSamples;
+        if (stable > depth)
+            applied = seen;
+    }
+
+    // reader side, audio thread
+    bool isActive(int channel) const
+    {
+        if (channel < 0 || channel >= max_channels)
+            return true;
+
+        auto w = applied[(std::size_t)(channel / 64)];
+        return ((w >> (channel % 64)) & 1) != 0;
+    }
+
+  private:
+    static Mask allActive()
+    {
+        Mask mask{};
+        mask.fill(~uint64_t{0});
+        return mask;
+    }
+
+    std::array<std::atomic<uint64_t>, num_words> words{};
+    std::atomic<bool> valid{false};
+
+    // audio thread, bitmap last read, bitmap in effect and samples since it
+    // last changed
+    Mask seen = allActive();
+    Mask applied = allActive();
+    int stable{0};
+};
@@ -0,0 +1,107 @@
+#pragma once
+#include <JuceHeader.h>
+
+#include "AudioKernels.h"
+
+#include <array>
+#include <cmath>
+
+// per-channel gain, mute and polarity of receive outputs or sent NDI
+// channels, applied by the copy kernels in the same pass. Changes ramp over
+// smooth_ms so they do not click.
+//
+// text form, one comma separated entry per channel, words in any order:
+//   -6         gain in dB
+//   mute       silent
+//   inv        polarity inverted
+//   -3 inv     both
+// an empty entry and channels after the last entry stay at unity
+class ChannelGains
+{
+  public:
+    static constexpr int max_channels = 256;
+    static constexpr int smooth_ms = 20;
+
+    using Targets = std::array<float, max_channels>;
+
+    // message thread, linear gains of all channels
+    static Targets parse(const String &s)
+    {
+        Targets t{};
+        t.fill(1.0f);
+
+        auto entries = StringArray::fromTokens(s, ",", "");
+        for (auto i = 0; i < jmin(entries.size(), max_channels); i++)
+        {
+            auto words = StringArray::fromTokens(entries[i].trim(), " ", "");
+            words.removeEmptyStrings();
+
+            auto gain = 1.0f;
+            for (auto &&w : words)
+            {
+                if (w == "mute")
+                    gain *= 0.0f;
+                else if (w == "inv")
+                    gain = -gain;
+                else if (w.startsWithIgnoreCase("-inf"))
+                    gain *= 0.0f;
+                else
+                    gain *= std::pow(10.0f, w.getFloatValue() / 20.0f);
+            }
+            t[(size_t)i] = gain;
+        }
+        return t;
+    }
+
+    // before playback, not concurrent with audio thread
+    void prepare(double sampleRate)
+    {
+        smooth_samples = jmax(1, (int)(sampleRate * smooth_ms / 1000.0));
+        current = targets;
+        remaining.fill(0);
+    }
+
+    // caller holds audio_lock, changed channels start ramping
+    void setTargets(const Targets &t)
+    {
+        for (size_t i = 0; i < (size_t)max_channels; i++)
+        {
+            if (t[i] != targets[i])
+                remaining[i] = smooth_samples;
+        }
+        targets = t;
+    }
+
+    // audio thread, gain of channel for the next block, once per block
+    AudioKernels::Ramp advance(int channel, int numSamples)
+    {
+        if (channel < 0 || channel >= max_channels)
+            return {};
+
+        auto c = (size_t)channel;
+        const auto start = current[c];
+        if (remaining[c] <= 0)
+            return {start, 0.0f};
+
+        // last ramp block takes the rest, ends on target
+        const auto n = remaining[c] <= numSamples ? numSamples : remaining[c];
+        const auto step = (targets[c] - start) / (float)n;
+        remaining[c] -= numSamples;
+        current[c] = remaining[c] > 0 ? start + step * (float)numSamples
+                                      : targets[c];
+        return {start, step};
+    }
+
+  private:
+    Targets targets = unity();
+    Targets current = unity();
+    std::array<int, max_channels> remaining{};
+    int smooth_samples = 1;
+
+    static Targets unity()
+    {
+        Targets t{};
+        t.fill(1.0f);
+        return t;
+    }
+};
@@ -0,0 +1,454 @@
+#pragma once
+#include <JuceHeader.h>
+
+#include "Trace.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#if !JUCE_WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// process-wide control endpoint on localhost TCP, use through
+// SharedResourcePointer<ControlServer>, listens from the first add
+//
+// line based protocol. The first line of a connection is "token <hex>" with
+// the token of this process from ndi_audio_io_control_<port>.token in the
+// temp directory, only the user can read it. Anything else closes the
+// connection. Then a batch is one or more commands ended by an empty line,
+// answered by result lines ended by an empty line:
+//   list                  one "instance <id>\t<send text>\t<recv text>" line
+//                         per instance
+//   send <ids> <text>     apply send text input, as typed in the editor
+//   recv <ids> <text>     apply receive text input
+//   quit                  close connection
+//   trace on|off          profiling builds, start or stop recording
+//   trace dump [name]     profiling builds, write Chrome trace JSON to a file
+//                         in the temp directory
+// <ids> is *, an id, a range 3-7 or a comma separated list of those.
+// A batch is checked completely before anything is applied, the last line is
+// "ok <n>" with number of applied configurations or "error <line>: <reason>"
+// and nothing applied. Batches are checked on the server thread and applied
+// on the message thread, the server thread waits for them.
+// A connection that sends an HTTP request or header line is dropped, so a web
+// page can not reach the endpoint through the browser.
+class ControlServer : private Thread
+{
+  public:
+    static constexpr int default_port = 55960;
+    static constexpr int max_port_tries = 10;
+    static constexpr int max_line = 65536;
+    static constexpr int idle_timeout_ms = 30000;
+
+    // implemented by each plugin instance
+    struct Client
+    {
+        virtual ~Client() = default;
+        virtual String getControlSendText() = 0;
+        virtual String getControlRecvText() = 0;
+        virtual void applyControlSendText(const String &text) = 0;
+        virtual void applyControlRecvText(const String &text) = 0;
+    };
+
+    ControlServer() : Thread("NDI control") {}
+
+    ~ControlServer() override
+    {
+        signalThreadShouldExit();
+        listener.close();
+        stopThread(2000);
+
+        if (port >= 0)
+            getTokenFile(port).deleteFile();
+    }
+
+    // returns id of the instance for clients, stable for its lifetime
+    int add(Client *c)
+    {
+        startThread(Thread::Priority::low);
+
+        std::scoped_lock lock{clients_mutex};
+        clients.push_back({++last_id, c});
+        return last_id;
+    }
+
+    // blocks while a batch is being applied on another thread
+    void remove(Client *c)
+    {
+        std::scoped_lock lock{clients_mutex};
+        clients.erase(std::remove_if(clients.begin(), clients.end(),
+                                     [c](const Entry &e)
+                                     { return e.client == c; }),
+                      clients.end());
+    }
+
+    // port in use, -1 while not listening
+    int getPort() const
+    {
+        return port.load();
+    }
+
+    // file holding the token for the endpoint on port
+    static File getTokenFile(int p)
+    {
+        return File::getSpecialLocation(File::tempDirectory)
+            .getChildFile("ndi_audio_io_control_" + String(p) + ".token");
+    }
+
+  private:
+    struct Entry
+    {
+        int id;
+        Client *client;
+    };
+
+    struct Op
+    {
+        int id;
+        bool send;
+        String text;
+    };
+
+    void run() override
+    {
+        // first process on the machine gets default port, others the next
+        auto p = -1;
+        for (auto i = 0; i < max_port_tries && p < 0; i++)
+            if (listener.createListener(default_port + i, "127.0.0.1"))
+                p = default_port + i;
+
+        if (p < 0)
+            return;
+
+        // no endpoint without a token only the user can read
+        if (!writeToken(p))
+        {
+            listener.close();
+            return;
+        }
+        port = p;
+
+        while (!threadShouldExit())
+        {
+            if (listener.waitUntilReady(true, 250) != 1)
+                continue;
+
+            std::unique_ptr<StreamingSocket> s{
+                listener.waitForNextConnection()};
+            if (s != nullptr)
+                serve(*s);
+        }
+    }
+
+    // one connection at a time, local tool traffic only
+    void serve(StreamingSocket &s)
+    {
+        std::string pending{};
+        StringArray batch{};
+        auto idle_ms = 0;
+        auto authorised = false;
+
+        while (!threadShouldExit() && s.isConnected())
+        {
+            auto ready = s.waitUntilReady(true, 250);
+            if (ready < 0)
+                return;
+            if (ready == 0)
+            {
+                idle_ms += 250;
+                if (idle_ms >= idle_timeout_ms)
+                    return;
+                continue;
+            }
+            idle_ms = 0;
+
+            char data[4096];
+            auto n = s.read(data, (int)sizeof(data), false);
+            if (n <= 0)
+                return;
+            pending.append(data, (size_t)n);
+
+            for (auto eol = pending.find('\n'); eol != std::string::npos;
+                 eol = pending.find('\n'))
+            {
+                auto line = String::fromUTF8(pending.data(), (int)eol)
+                                .trimCharactersAtEnd("\r");
+                pending.erase(0, eol + 1);
+
+                if (line.trim() == "quit" || isHttp(line))
+                    return;
+
+                // first line proves the client can read the token file
+                if (!authorised)
+                {
+                    if (line.trim() != "token " + token)
+                        return;
+                    authorised = true;
+                    continue;
+                }
+
+                if (line.trim().isNotEmpty())
+                {
+                    batch.add(line);
+                    continue;
+                }
+
+                if (batch.isEmpty())
+                    continue;
+
+                auto reply = execute(batch) + "\n";
+                batch.clear();
+                if (s.write(reply.toRawUTF8(),
+                            (int)reply.getNumBytesAsUTF8()) < 0)
+                    return;
+            }
+
+            if (pending.size() > (size_t)max_line)
+                return;
+        }
+    }
+
+    // request line or header of a browser, never a command
+    static bool isHttp(const String &line)
+    {
+        static const StringArray methods{"GET",   "POST",    "PUT",
+                                         "HEAD",  "DELETE",  "OPTIONS",
+                                         "TRACE", "CONNECT", "PATCH"};
+        auto first = line.upToFirstOccurrenceOf(" ", false, false);
+        auto name = line.upToFirstOccurrenceOf(":", false, false).trim();
+        return methods.contains(first) || line.contains(" HTTP/") ||
+               name.equalsIgnoreCase("Host") ||
+               name.equalsIgnoreCase("Origin");
+    }
+
+    // random per process, written to a file created anew with user-only
+    // permissions, fails on one someone else created meanwhile
+    bool writeToken(int p)
+    {
+        std::random_device random{};
+        token.clear();
+        for (auto i = 0; i < 4; i++)
+            token << String::toHexString((uint32)random()).paddedLeft('0', 8);
+
+        auto file = getTokenFile(p);
+        file.deleteFile();
+        const auto text = token + "\n";
+#if JUCE_WINDOWS
+        // temp directory is in the user profile
+        return file.replaceWithText(text);
+#else
+        auto fd = ::open(file.getFullPathName().toRawUTF8(),
+                         O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW, 0600);
+        if (fd < 0)
+            return false;
+        const auto size = (ssize_t)text.getNumBytesAsUTF8();
+        const auto written = ::write(fd, text.toRawUTF8(), (size_t)size);
+        ::close(fd);
+        return written == size;
+#endif
+    }
+
+    // trace file name in the temp directory, nothing outside of it
+    static File traceFile(const String &name)
+    {
+        if (name.isEmpty() || name.startsWithChar('.') ||
+            File::createLegalFileName(name) != name)
+            return {};
+        return File::getSpecialLocation(File::tempDirectory)
+            .getChildFile(name);
+    }
+
+    // ids known at execution time, empty result if spec is invalid
+    std::vector<Entry> resolve(const String &spec) const
+    {
+        std::vector<Entry> found{};
+        if (spec == "*")
+            return clients;
+
+        auto t = StringArray::fromTokens(spec, ",", "");
+        for (auto &&k : t)
+        {
+            auto first = k.upToFirstOccurrenceOf("-", false, false).trim();
+            auto last = k.containsChar('-')
+                            ? k.fromFirstOccurrenceOf("-", false, false).trim()
+                            : first;
+            if (!first.containsOnly("0123456789") ||
+                !last.containsOnly("0123456789") || first.isEmpty() ||
+                last.isEmpty())
+                return {};
+
+            for (auto id = first.getIntValue(); id <= last.getIntValue();
+                 id++)
+            {
+                auto it = std::find_if(clients.begin(), clients.end(),
+                                       [id](const Entry &e)
+                                       { return e.id == id; });
+                if (it == clients.end())
+                    return {};
+                found.push_back(*it);
+            }
+        }
+        return found;
+    }
+
+    // checks the batch under clients_mutex, then applies it on the message
+    // thread without holding the mutex here
+    String execute(const StringArray &batch)
+    {
+        String out{};
+        std::vector<Op> ops{};
+        {
+            std::scoped_lock lock{clients_mutex};
+            auto error = check(batch, out, ops);
+            if (error.isNotEmpty())
+                return error;
+        }
+
+        if (ops.empty())
+            return out + "ok 0\n";
+
+        auto applied = applyOnMessageThread(std::move(ops));
+        if (applied < 0)
+            return "error 0: message thread not available\n";
+
+        return out + "ok " + String(applied) + "\n";
+    }
+
+    // caller holds clients_mutex. Returns the error reply, empty if ops
+    // can be applied, answers to list are added to out.
+    String check(const StringArray &batch, String &out, std::vector<Op> &ops)
+    {
+        for (auto i = 0; i < batch.size(); i++)
+        {
+            auto line = batch[i].trim();
+            auto command = line.upToFirstOccurrenceOf(" ", false, false);
+            auto args = line.fromFirstOccurrenceOf(" ", false, false).trim();
+
+            if (command == "list")
+            {
+                for (auto &&e : clients)
+                    out << "instance " << e.id << "\t"
+                        << e.client->getControlSendText() << "\t"
+                        << e.client->getControlRecvText() << "\n";
+                continue;
+            }
+
+#if NDI_AUDIO_IO_TRACE
+            // applied at once, recording is not part of the configuration
+            if (command == "trace")
+            {
+                auto what = args.upToFirstOccurrenceOf(" ", false, false);
+                auto name =
+                    args.fromFirstOccurrenceOf(" ", false, false).trim();
+                auto file = traceFile(name);
+                if (what == "on" || what == "off")
+                    Trace::setEnabled(what == "on");
+                else if (what != "dump")
+                    return "error " + String(i + 1) + ": unknown trace " +
+                           what + "\n";
+                else if (name.isNotEmpty() && file == File{})
+                    return "error " + String(i + 1) +
+                           ": trace name not a plain file name\n";
+                else if (!Trace::dump(name.isEmpty()
+                                          ? nullptr
+                                          : file.getFullPathName()
+                                                .toRawUTF8()))
+                    return "error " + String(i + 1) +
+                           ": can not write trace\n";
+                continue;
+            }
+#endif
+
+            if (command == "send" || command == "recv")
+            {
+                auto spec = args.upToFirstOccurrenceOf(" ", false, false);
+                auto text = args.fromFirstOccurrenceOf(" ", false, false);
+                auto targets = resolve(spec);
+                if (targets.empty())
+                    return "error " + String(i + 1) + ": unknown instance " +
+                           spec + "\n";
+
+                for (auto &&e : targets)
+                    ops.push_back({e.id, command == "send", text.trim()});
+                continue;
+            }
+
+            return "error " + String(i + 1) + ": unknown command " + command +
+                   "\n";
+        }
+
+        return {};
+    }
+
+    // blocks until the message thread has applied ops, number applied or -1
+    // if it can not. Job and server may outlive each other.
+    int applyOnMessageThread(std::vector<Op> ops)
+    {
+        struct Job
+        {
+            std::vector<Op> ops;
+            std::atomic<int> applied{-1};
+            WaitableEvent done{};
+        };
+
+        auto job = std::make_shared<Job>();
+        job->ops = std::move(ops);
+        WeakReference<ControlServer> self{this};
+
+        auto posted = MessageManager::callAsync(
+            [self, job]
+            {
+                if (auto *s = self.get())
+                    job->applied = s->apply(job->ops);
+                job->done.signal();
+            });
+        if (!posted)
+            return -1;
+
+        // destructor runs on the message thread, stop waiting for it
+        while (!job->done.wait(250))
+            if (threadShouldExit())
+                return -1;
+
+        return job->applied;
+    }
+
+    // message thread, instances removed since the check are skipped
+    int apply(const std::vector<Op> &ops)
+    {
+        std::scoped_lock lock{clients_mutex};
+
+        auto applied = 0;
+        for (auto &&op : ops)
+        {
+            auto it = std::find_if(clients.begin(), clients.end(),
+                                   [&op](const Entry &e)
+                                   { return e.id == op.id; });
+            if (it == clients.end())
+                continue;
+
+            if (op.send)
+                it->client->applyControlSendText(op.text);
+            else
+                it->client->applyControlRecvText(op.text);
+            applied++;
+        }
+        return applied;
+    }
+
+    StreamingSocket listener{};
+    std::atomic<int> port{-1};
+    String token{}; // server thread
+
+    std::mutex clients_mutex;
+    std::vector<Entry> clients{};
+    int last_id = 0;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(ControlServer)
+};
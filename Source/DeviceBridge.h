@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+
+// processor that can run directly on audio device buffers, used by the
+// standalone holder instead of AudioProcessorPlayer when available
+struct DeviceBridge
+{
+    virtual ~DeviceBridge() = default;
+
+    // audio thread, device inputs to send and received audio to every device
+    // output. Returns false to have the block processed the regular way.
+    // hostTimeNs is the device time of the block, nullptr if not reported.
+    virtual bool processDeviceBlock(const float *const *inputs, int numInputs,
+                                    float *const *outputs, int numOutputs,
+                                    int numSamples,
+                                    const std::uint64_t *hostTimeNs) = 0;
+};
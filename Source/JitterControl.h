@@ -0,0 +1,115 @@
+#pragma once
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <cmath>
+
+// receive buffer depth controller, audio thread except the getters
+// jitter is estimated from how the frame-sync queue depth moves between
+// pulls, as running mean deviation of samples arrived per block from the
+// block size (RFC 3550 style). Underruns raise the target, which relaxes
+// again while the link stays clean. The queue is moved towards the target
+// by pulling one sample more or less than the block, the caller stretches
+// that over the block.
+class JitterControl
+{
+  public:
+    // bounds in ms, max_ms 0 turns the controller off
+    void setBounds(int min_ms, int max_ms)
+    {
+        bound_min_ms = jmax(0, min_ms);
+        bound_max_ms = jmax(bound_min_ms, max_ms);
+        reset();
+    }
+
+    bool isActive() const
+    {
+        return bound_max_ms > 0;
+    }
+
+    // new connection, history of the old one does not apply
+    void reset()
+    {
+        jitter = 0.0;
+        boost = 0.0;
+        level = -1.0;
+        last_depth = -1;
+        last_pull = 0;
+        clean_samples = 0;
+        target_shared.store(isActive() ? 0 : -1, std::memory_order_relaxed);
+        underruns_shared.store(0, std::memory_order_relaxed);
+    }
+
+    // depth queued before this pull, returns samples to pull for numSamples
+    int pull(int depth, int numSamples, int sampleRate)
+    {
+        if (last_depth >= 0)
+        {
+            auto arrived = depth - jmax(0, last_depth - last_pull);
+            jitter += (std::abs(arrived - numSamples) - jitter) / 16.0;
+        }
+
+        if (depth < numSamples)
+        {
+            boost += numSamples;
+            clean_samples = 0;
+            underruns_shared.fetch_add(1, std::memory_order_relaxed);
+        }
+        else if ((clean_samples += numSamples) >= sampleRate)
+        {
+            // an eighth less per clean second
+            boost *= 0.875;
+            clean_samples = 0;
+        }
+
+        const auto min_depth = bound_min_ms * sampleRate / 1000;
+        const auto max_depth = bound_max_ms * sampleRate / 1000;
+        boost = jmin(boost, (double)max_depth);
+        const auto target =
+            jlimit(min_depth, max_depth, (int)(2.0 * jitter + boost));
+
+        // what stays queued after the pull, averaged over about a second
+        const auto left = (double)(depth - numSamples);
+        const auto rate = jmin(1.0, (double)numSamples / sampleRate);
+        level = level < 0.0 ? left : level + (left - level) * rate;
+
+        auto n = numSamples;
+        const auto hysteresis = jmax(32, target / 8);
+        if (level < target - hysteresis)
+            n = numSamples - 1;
+        else if (level > target + hysteresis && depth > numSamples)
+            n = numSamples + 1;
+
+        last_depth = depth;
+        last_pull = n;
+        target_shared.store(target * 1000 / sampleRate,
+                            std::memory_order_relaxed);
+        return n;
+    }
+
+    // any thread, target depth in ms, -1 while off
+    int getTargetMs() const
+    {
+        return target_shared.load(std::memory_order_relaxed);
+    }
+
+    // any thread, underruns since connecting
+    int getUnderruns() const
+    {
+        return underruns_shared.load(std::memory_order_relaxed);
+    }
+
+  private:
+    int bound_min_ms{0};
+    int bound_max_ms{0};
+
+    double jitter{0.0};
+    double boost{0.0};
+    double level{-1.0};
+    int last_depth{-1};
+    int last_pull{0};
+    int clean_samples{0};
+
+    std::atomic<int> target_shared{-1};
+    std::atomic<int> underruns_shared{0};
+};
@@ -0,0 +1,133 @@
+#pragma once
+#include "AudioKernels.h"
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+
+// per-channel peak and rms over a fixed window
+// audio thread accumulates block levels and publishes each finished window
+// into one of two snapshot buffers, then bumps sequence. A reader copies the
+// buffer sequence points at and keeps it only if sequence did not move
+// meanwhile, so it has a whole window to finish without any lock.
+class LevelMeter
+{
+  public:
+    static constexpr int max_channels = 256;
+
+    struct Snapshot
+    {
+        uint32_t sequence = 0;
+        int channels = 0;
+        std::array<float, max_channels> peak{};
+        std::array<float, max_channels> rms{};
+    };
+
+    // before playback, not concurrent with audio thread
+    void prepare(int window_samples)
+    {
+        window = window_samples > 0 ? window_samples : 1;
+        acc_samples = 0;
+        acc_channels = 0;
+        acc_peak.fill(0.0f);
+        acc_sum.fill(0.0f);
+    }
+
+    // audio thread, levels of one block for one channel
+    void add(int channel, const AudioKernels::Levels &levels)
+    {
+        if (channel < 0 || channel >= max_channels)
+            return;
+
+        auto c = (std::size_t)channel;
+        acc_peak[c] = acc_peak[c] > levels.peak ? acc_peak[c] : levels.peak;
+        acc_sum[c] += levels.sum_squares;
+    }
+
+    // audio thread, after all channels of a block were added
+    void advance(int channels, int numSamples)
+    {
+        channels = channels < max_channels ? channels : max_channels;
+        acc_channels = acc_channels > channels ? acc_channels : channels;
+        acc_samples += numSamples;
+        if (acc_samples >= window)
+            publish();
+    }
+
+    // any thread, false if nothing new since dst was filled or writer
+    // overtook the copy, dst keeps previous contents then
+    bool read(Snapshot &dst) const
+    {
+        auto s = sequence.load(std::memory_order_acquire);
+        if (s == 0 || s == dst.sequence)
+            return false;
+
+        const auto &b = buffers[s & 1];
+        auto channels = b.channels.load(std::memory_order_relaxed);
+        Snapshot tmp{};
+        for (auto i = 0; i < channels; i++)
+        {
+            tmp.peak[(std::size_t)i] =
+                b.peak[(std::size_t)i].load(std::memory_order_relaxed);
+            tmp.rms[(std::size_t)i] =
+                b.rms[(std::size_t)i].load(std::memory_order_relaxed);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) != s)
+            return false;
+
+        tmp.sequence = s;
+        tmp.channels = channels;
+        dst = tmp;
+        return true;
+    }
+
+  private:
+    struct Buffer
+    {
+        std::atomic<int> channels{0};
+        std::array<std::atomic<float>, max_channels> peak{};
+        std::array<std::atomic<float>, max_channels> rms{};
+    };
+
+    void publish()
+    {
+        auto next = sequence.load(std::memory_order_relaxed) + 1;
+        if (next == 0)
+            next = 1;
+
+        // previous sequence store must not sink below these buffer writes,
+        // pairs with fence in read()
+        std::atomic_thread_fence(std::memory_order_release);
+
+        auto &b = buffers[next & 1];
+        auto scale = 1.0f / (float)acc_samples;
+        for (auto i = 0; i < acc_channels; i++)
+        {
+            auto c = (std::size_t)i;
+            b.peak[c].store(acc_peak[c], std::memory_order_relaxed);
+            b.rms[c].store(std::sqrt(acc_sum[c] * scale),
+                           std::memory_order_relaxed);
+            acc_peak[c] = 0.0f;
+            acc_sum[c] = 0.0f;
+        }
+        b.channels.store(acc_channels, std::memory_order_relaxed);
+
+        sequence.store(next, std::memory_order_release);
+
+        acc_samples = 0;
+        acc_channels = 0;
+    }
+
+    std::array<Buffer, 2> buffers{};
+    std::atomic<uint32_t> sequence{0};
+
+    // audio thread only
+    std::array<float, max_channels> acc_peak{};
+    std::array<float, max_channels> acc_sum{};
+    int acc_channels = 0;
+    int acc_samples = 0;
+    int window = 2400;
+};
@@ -0,0 +1,248 @@
+#pragma once
+#include <JuceHeader.h>
+
+#include <atomic>
+#include <cmath>
+
+// receive dropout concealment over storage carved by the caller, audio thread
+// keeps a short history of every output channel. When the frame-sync runs
+// dry the missing part of the block continues the waveform periodically,
+// with the period that best matches the last few ms (waveform similarity on
+// the sum of all channels, so the search costs the same at any channel
+// count). Real audio crossfades into and out of the extrapolation, long
+// outages fade to silence. All channels use the same period, the per-channel
+// work is plain contiguous runs the compiler vectorises.
+class LossConcealer
+{
+  public:
+    static constexpr double min_lag_ms = 2.5;
+    static constexpr double max_lag_ms = 15.0;
+    static constexpr double window_ms = 5.0;
+    static constexpr double crossfade_ms = 2.5;
+    static constexpr double hold_ms = 20.0;
+    static constexpr double fade_ms = 40.0;
+
+    // power of two history per channel for sample rate
+    static int historyLength(double sampleRate)
+    {
+        const auto span = (max_lag_ms + window_ms) * sampleRate / 1000.0;
+        return (int)nextPowerOfTwo(jmax(64, (int)std::ceil(span)));
+    }
+
+    // storage: historyLength() per channel plus one more for the search
+    void setup(float *storage, int num_channels, double sampleRate)
+    {
+        ring = storage;
+        channels = storage ? num_channels : 0;
+        length = historyLength(sampleRate);
+        mask = length - 1;
+        search = storage ? storage + (size_t)channels * (size_t)length
+                         : nullptr;
+
+        auto samples = [sampleRate](double ms)
+        { return jmax(1, (int)(ms * sampleRate / 1000.0)); };
+        min_lag = samples(min_lag_ms);
+        max_lag = samples(max_lag_ms);
+        window = samples(window_ms);
+        crossfade = samples(crossfade_ms);
+        hold = samples(hold_ms);
+        fade = samples(fade_ms);
+        reset();
+    }
+
+    // new connection, the old history does not continue into it
+    void reset()
+    {
+        write = 0;
+        concealing = false;
+        primed = false;
+        concealed = 0;
+        if (ring != nullptr)
+            FloatVectorOperations::clear(ring, channels * length);
+        events_shared.store(0, std::memory_order_relaxed);
+    }
+
+    // first valid samples of the block are real audio, the rest is padding
+    // from a starved frame-sync and gets replaced
+    template <typename T>
+    void process(T *const *outputs, int num_channels, int numSamples,
+                 int valid)
+    {
+        if (ring == nullptr)
+            return;
+
+        num_channels = jmin(num_channels, channels);
+        valid = jlimit(0, numSamples, valid);
+
+        auto t = 0;
+        if (concealing && valid > 0)
+        {
+            // out of the gap, extrapolation fades under the real audio
+            auto n = jmin(crossfade, valid);
+            for (auto c = 0; c < num_channels; c++)
+            {
+                auto h = ring + (size_t)c * (size_t)length;
+                auto p = outputs[c];
+                for (auto j = 0; j < n; j++)
+                {
+                    auto w = (float)(j + 1) / (float)(n + 1);
+                    auto e = h[(write + j - lag) & mask] *
+                             gainAt(concealed + j);
+                    auto x = static_cast<float>(p[j]);
+                    p[j] = static_cast<T>(e + (x - e) * w);
+                }
+            }
+            record(outputs, num_channels, 0, n);
+            concealing = false;
+            t = n;
+        }
+
+        record(outputs, num_channels, t, valid);
+        if (valid == numSamples)
+        {
+            primed = true;
+            write = (write + numSamples) & mask;
+            return;
+        }
+
+        if (!concealing)
+        {
+            lag = findLag(num_channels, valid);
+            concealing = true;
+            concealed = 0;
+            if (primed)
+                events_shared.fetch_add(1, std::memory_order_relaxed);
+
+            // into the gap, real audio fades under the extrapolation
+            auto n = jmin(crossfade, valid);
+            for (auto c = 0; c < num_channels; c++)
+            {
+                auto h = ring + (size_t)c * (size_t)length;
+                auto p = outputs[c];
+                for (auto j = valid - n; j < valid; j++)
+                {
+                    auto w = (float)(j - valid + n + 1) / (float)(n + 1);
+                    auto x = h[(write + j) & mask];
+                    auto e = h[(write + j - lag) & mask];
+                    x += (e - x) * w;
+                    h[(write + j) & mask] = x;
+                    p[j] = static_cast<T>(x);
+                }
+            }
+        }
+
+        // periodic continuation, runs where neither read nor write wraps
+        for (auto j = valid; j < numSamples;)
+        {
+            auto r = (write + j - lag) & mask;
+            auto w = (write + j) & mask;
+            auto n = jmin(numSamples - j, lag, length - r, length - w);
+            const auto g0 = 1.0f - (float)(concealed - hold) / (float)fade;
+            const auto dg = 1.0f / (float)fade;
+
+            for (auto c = 0; c < num_channels; c++)
+            {
+                auto h = ring + (size_t)c * (size_t)length;
+                auto p = outputs[c] + j;
+                for (auto k = 0; k < n; k++)
+                {
+                    auto g = jlimit(0.0f, 1.0f, g0 - dg * (float)k);
+                    h[w + k] = h[r + k];
+                    p[k] = static_cast<T>(h[w + k] * g);
+                }
+            }
+            concealed += n;
+            j += n;
+        }
+
+        write = (write + numSamples) & mask;
+    }
+
+    // any thread, dropouts concealed since connecting
+    int getEvents() const
+    {
+        return events_shared.load(std::memory_order_relaxed);
+    }
+
+  private:
+    float gainAt(int n) const
+    {
+        return jlimit(0.0f, 1.0f, 1.0f - (float)(n - hold) / (float)fade);
+    }
+
+    // samples [from, to) of the block into the history
+    template <typename T>
+    void record(T *const *outputs, int num_channels, int from, int to)
+    {
+        for (auto j = from; j < to;)
+        {
+            auto w = (write + j) & mask;
+            auto n = jmin(to - j, length - w);
+            for (auto c = 0; c < num_channels; c++)
+            {
+                auto h = ring + (size_t)c * (size_t)length + w;
+                auto p = outputs[c] + j;
+                for (auto k = 0; k < n; k++)
+                    h[k] = static_cast<float>(p[k]);
+            }
+            j += n;
+        }
+    }
+
+    // period whose past best matches the last window before the gap
+    int findLag(int num_channels, int end)
+    {
+        // channel sum of the searched span, oldest first
+        const auto span = window + max_lag;
+        FloatVectorOperations::clear(search, span);
+        for (auto c = 0; c < num_channels; c++)
+        {
+            auto h = ring + (size_t)c * (size_t)length;
+            for (auto k = 0; k < span; k++)
+                search[k] += h[(write + end - span + k) & mask];
+        }
+
+        const auto *target = search + max_lag;
+        auto best = max_lag;
+        auto best_score = 0.0f;
+        for (auto l = min_lag; l <= max_lag; l++)
+        {
+            const auto *candidate = target - l;
+            auto dot = 0.0f;
+            auto energy = 0.0f;
+            for (auto k = 0; k < window; k++)
+            {
+                dot += target[k] * candidate[k];
+                energy += candidate[k] * candidate[k];
+            }
+            auto score = energy > 0.0f ? dot / std::sqrt(energy) : 0.0f;
+            if (score > best_score)
+            {
+                best_score = score;
+                best = l;
+            }
+        }
+        return best;
+    }
+
+    float *ring = nullptr;
+    float *search = nullptr;
+    int channels = 0;
+    int length = 0;
+    int mask = 0;
+    int write = 0;
+
+    int min_lag = 1;
+    int max_lag = 1;
+    int window = 1;
+    int crossfade = 1;
+    int hold = 1;
+    int fade = 1;
+
+    bool concealing = false;
+    bool primed = false;
+    int lag = 1;
+    int concealed = 0;
+
+    std::atomic<int> events_shared{0};
+};
@@ -0,0 +1,587 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Lossless coding of planar float audio, one block of all channels per
+// packet. Each channel is coded on its own:
+//
+//   zero       every sample +0.0
+//   predicted  samples are 24 bit fixed point (k / 2^23, |k| <= 2^24), shifted
+//              right by the low bits no sample uses, a fixed polynomial
+//              predictor of order 0-4 picked per block, residuals Rice coded
+//              with one parameter per block
+//   verbatim   float bits as they are, for anything else (DSP output, NaN,
+//              -0.0) and whenever predicted would not be smaller
+//
+// so decoding gives the same bits back in every case. Fixed-point check and
+// float conversion are branch free loops over contiguous samples the
+// compiler vectorizes, the coder itself is scalar.
+//
+// Packet, little endian:
+//
+//   u32 fourcc 'NDLL', u16 version, u16 channels, u32 samples,
+//   u32 sample rate, i64 timecode (100 ns), u32 size per channel,
+//   channel payloads in channel order
+//
+// NDI audio frames are float only and resampled by the frame-sync, packets
+// travel base64 encoded in metadata frames as
+// <ndi_audio_lossless fourcc="NDLL">...</ndi_audio_lossless>. Receivers that
+// do not know the element ignore it. No JUCE here.
+namespace LosslessCodec
+{
+constexpr std::uint32_t fourcc = 0x4c4c444e; // "NDLL"
+constexpr int version = 1;
+constexpr int max_channels = 256;
+constexpr int max_samples = 1 << 16;
+constexpr int max_order = 4;
+constexpr std::size_t header_bytes = 24;
+constexpr auto tag = "<ndi_audio_lossless";
+constexpr auto open_tag = "<ndi_audio_lossless fourcc=\"NDLL\">";
+constexpr auto close_tag = "</ndi_audio_lossless>";
+
+enum Mode : std::uint8_t
+{
+    zero,
+    verbatim,
+    predicted
+};
+
+struct Header
+{
+    int channels = 0;
+    int samples = 0;
+    int sample_rate = 0;
+    std::int64_t timecode = 0;
+};
+
+// payload of one channel never exceeds this, verbatim is the fallback
+constexpr std::size_t maxChannelBytes(int numSamples)
+{
+    return 4 + (std::size_t)numSamples * 4;
+}
+
+// header and size table
+constexpr std::size_t headerBytes(int numChannels)
+{
+    return header_bytes + (std::size_t)numChannels * 4;
+}
+
+constexpr std::size_t maxPacketBytes(int numChannels, int numSamples)
+{
+    return headerBytes(numChannels) +
+           (std::size_t)numChannels * maxChannelBytes(numSamples);
+}
+
+constexpr std::size_t base64Bytes(std::size_t n)
+{
+    return (n + 2) / 3 * 4;
+}
+
+// metadata element of a packet, with terminator
+inline std::size_t maxXmlBytes(std::size_t packetBytes)
+{
+    return std::strlen(open_tag) + base64Bytes(packetBytes) +
+           std::strlen(close_tag) + 1;
+}
+
+namespace detail
+{
+inline void put16(std::uint8_t *p, std::uint32_t v)
+{
+    p[0] = (std::uint8_t)v;
+    p[1] = (std::uint8_t)(v >> 8);
+}
+
+inline void put32(std::uint8_t *p, std::uint32_t v)
+{
+    put16(p, v);
+    put16(p + 2, v >> 16);
+}
+
+inline void put64(std::uint8_t *p, std::uint64_t v)
+{
+    put32(p, (std::uint32_t)v);
+    put32(p + 4, (std::uint32_t)(v >> 32));
+}
+
+inline std::uint32_t get16(const std::uint8_t *p)
+{
+    return (std::uint32_t)p[0] | (std::uint32_t)p[1] << 8;
+}
+
+inline std::uint32_t get32(const std::uint8_t *p)
+{
+    return get16(p) | get16(p + 2) << 16;
+}
+
+inline std::uint64_t get64(const std::uint8_t *p)
+{
+    return (std::uint64_t)get32(p) | (std::uint64_t)get32(p + 4) << 32;
+}
+
+inline int countLeadingZeros(std::uint64_t x)
+{
+#if defined(_MSC_VER)
+    unsigned long i = 0;
+    _BitScanReverse64(&i, x);
+    return 63 - (int)i;
+#else
+    return __builtin_clzll(x);
+#endif
+}
+
+inline std::uint32_t zigzag(std::int32_t e)
+{
+    return e < 0 ? ((std::uint32_t)-(e + 1) << 1) | 1u : (std::uint32_t)e << 1;
+}
+
+inline std::int64_t unzigzag(std::uint32_t u)
+{
+    return (u & 1u) ? -(std::int64_t)(u >> 1) - 1 : (std::int64_t)(u >> 1);
+}
+
+// fixed polynomial prediction of x[i] from the order samples before it
+template <typename T>
+inline T predict(const T *x, int i, int order)
+{
+    switch (order)
+    {
+    case 1:
+        return x[i - 1];
+    case 2:
+        return 2 * x[i - 1] - x[i - 2];
+    case 3:
+        return 3 * x[i - 1] - 3 * x[i - 2] + x[i - 3];
+    case 4:
+        return 4 * x[i - 1] - 6 * x[i - 2] + 4 * x[i - 3] - x[i - 4];
+    default:
+        return 0;
+    }
+}
+
+// msb first
+class BitWriter
+{
+  public:
+    explicit BitWriter(std::uint8_t *dst) : p(dst)
+    {
+    }
+
+    // bits <= 32
+    void put(std::uint32_t v, int bits)
+    {
+        acc = acc << bits | v;
+        count += bits;
+        while (count >= 8)
+        {
+            count -= 8;
+            *p++ = (std::uint8_t)(acc >> count);
+        }
+    }
+
+    void putZeros(std::uint32_t n)
+    {
+        for (; n >= 32; n -= 32)
+            put(0, 32);
+        put(0, (int)n);
+    }
+
+    std::uint8_t *flush()
+    {
+        if (count > 0)
+            *p++ = (std::uint8_t)(acc << (8 - count));
+        count = 0;
+        return p;
+    }
+
+  private:
+    std::uint8_t *p;
+    std::uint64_t acc = 0;
+    int count = 0;
+};
+
+// msb first, bounds checked
+class BitReader
+{
+  public:
+    BitReader(const std::uint8_t *src, std::size_t size)
+        : p(src), end(src + size)
+    {
+    }
+
+    bool rice(int k, std::uint32_t &u)
+    {
+        std::uint32_t q = 0;
+        for (;;)
+        {
+            fill();
+            if (count == 0)
+                return false;
+            // bits below count are zero, a set bit is a valid one
+            if (acc == 0)
+            {
+                q += (std::uint32_t)count;
+                count = 0;
+                if (q > 0xffffffffu >> k)
+                    return false;
+                continue;
+            }
+            const auto z = countLeadingZeros(acc);
+            q += (std::uint32_t)z;
+            acc = (acc << z) << 1;
+            count -= z + 1;
+            break;
+        }
+
+        if (q > 0xffffffffu >> k)
+            return false;
+        if (k == 0)
+        {
+            u = q;
+            return true;
+        }
+
+        fill();
+        if (count < k)
+            return false;
+        u = q << k | (std::uint32_t)(acc >> (64 - k));
+        acc <<= k;
+        count -= k;
+        return true;
+    }
+
+  private:
+    void fill()
+    {
+        for (; count <= 56 && p < end; count += 8)
+            acc |= (std::uint64_t)*p++ << (56 - count);
+    }
+
+    const std::uint8_t *p;
+    const std::uint8_t *end;
+    std::uint64_t acc = 0;
+    int count = 0;
+};
+} // namespace detail
+
+// 24 bit fixed point of every sample into q, false if one does not come
+// back as the same float bits
+inline bool toFixed(const float *src, int numSamples, std::int32_t *q)
+{
+    std::uint32_t mismatch = 0;
+    for (auto i = 0; i < numSamples; i++)
+    {
+        // clamped first, NaN and overflow convert to a value that fails
+        const auto x = std::fmin(std::fmax(src[i] * 8388608.0f, -16777216.0f),
+                                 16777216.0f);
+        q[i] = (std::int32_t)x;
+
+        const auto back = (float)q[i] * (1.0f / 8388608.0f);
+        std::uint32_t a = 0;
+        std::uint32_t b = 0;
+        std::memcpy(&a, &back, 4);
+        std::memcpy(&b, &src[i], 4);
+        mismatch |= a ^ b;
+    }
+    return mismatch == 0;
+}
+
+// codes numSamples of one channel into dst, which holds
+// maxChannelBytes(numSamples). q is scratch for numSamples values.
+// Returns bytes written.
+inline std::size_t encodeChannel(const float *src, int numSamples,
+                                 std::int32_t *q, std::uint8_t *dst)
+{
+    const auto verbatim_bytes = 1 + (std::size_t)numSamples * 4;
+    auto writeVerbatim = [&]
+    {
+        dst[0] = verbatim;
+        for (auto i = 0; i < numSamples; i++)
+        {
+            std::uint32_t bits = 0;
+            std::memcpy(&bits, &src[i], 4);
+            detail::put32(dst + 1 + (std::size_t)i * 4, bits);
+        }
+        return verbatim_bytes;
+    };
+
+    if (!toFixed(src, numSamples, q))
+        return writeVerbatim();
+
+    std::uint32_t used = 0;
+    for (auto i = 0; i < numSamples; i++)
+        used |= (std::uint32_t)q[i];
+
+    if (used == 0)
+    {
+        dst[0] = zero;
+        return 1;
+    }
+
+    // low bits no sample uses, e.g. 16 bit sources
+    auto shift = 0;
+    while (shift < 24 && ((used >> shift) & 1u) == 0)
+        shift++;
+    if (shift > 0)
+        for (auto i = 0; i < numSamples; i++)
+            q[i] >>= shift;
+
+    // residual magnitude of every order in one pass, values stay within
+    // 2^24 so order 4 residuals fit 32 bits
+    std::uint64_t sums[max_order + 1]{};
+    for (auto i = max_order; i < numSamples; i++)
+    {
+        const auto a = q[i];
+        const auto b = q[i - 1];
+        const auto c = q[i - 2];
+        const auto d = q[i - 3];
+        const auto e = q[i - 4];
+        sums[0] += (std::uint32_t)std::abs(a);
+        sums[1] += (std::uint32_t)std::abs(a - b);
+        sums[2] += (std::uint32_t)std::abs(a - 2 * b + c);
+        sums[3] += (std::uint32_t)std::abs(a - 3 * b + 3 * c - d);
+        sums[4] += (std::uint32_t)std::abs(a - 4 * b + 6 * c - 4 * d + e);
+    }
+
+    auto order = 0;
+    for (auto o = 1; o <= max_order; o++)
+        if (sums[o] < sums[order])
+            order = o;
+    if (numSamples <= max_order)
+        order = 0;
+
+    // zigzag doubles the magnitude, pick k for the smallest estimate
+    const auto n = (std::uint64_t)(numSamples > max_order
+                                       ? numSamples - max_order
+                                       : 1);
+    const auto zigzag_sum = sums[order] * 2;
+    auto k = 0;
+    auto best = ~(std::uint64_t)0;
+    for (auto r = 0; r <= 30; r++)
+    {
+        const auto bits = n * (std::uint64_t)(r + 1) + (zigzag_sum >> r);
+        if (bits < best)
+        {
+            best = bits;
+            k = r;
+        }
+    }
+
+    dst[0] = predicted;
+    dst[1] = (std::uint8_t)order;
+    dst[2] = (std::uint8_t)shift;
+    dst[3] = (std::uint8_t)k;
+
+    // gives up as soon as it would not be smaller than verbatim
+    const auto limit = (std::uint64_t)(verbatim_bytes - 4) * 8;
+    std::uint64_t bits = 0;
+    detail::BitWriter out{dst + 4};
+    for (auto i = 0; i < numSamples; i++)
+    {
+        // first samples of a block use the orders they have history for
+        const auto o = i < order ? i : order;
+        const auto u = detail::zigzag(q[i] - detail::predict(q, i, o));
+        const auto high = u >> k;
+
+        bits += (std::uint64_t)high + 1 + (std::uint64_t)k;
+        if (bits > limit)
+            return writeVerbatim();
+
+        out.putZeros(high);
+        out.put(1, 1);
+        if (k > 0)
+            out.put(u & ((1u << k) - 1), k);
+    }
+    return (std::size_t)(out.flush() - dst);
+}
+
+// numSamples of one channel from a payload of size bytes, q is scratch for
+// numSamples values. False if the payload is not valid.
+inline bool decodeChannel(const std::uint8_t *src, std::size_t size,
+                          float *dst, int numSamples, std::int32_t *q)
+{
+    if (size < 1)
+        return false;
+
+    if (src[0] == zero)
+    {
+        std::memset(dst, 0, (std::size_t)numSamples * sizeof(float));
+        return size == 1;
+    }
+
+    if (src[0] == verbatim)
+    {
+        if (size != 1 + (std::size_t)numSamples * 4)
+            return false;
+        for (auto i = 0; i < numSamples; i++)
+        {
+            const auto bits = detail::get32(src + 1 + (std::size_t)i * 4);
+            std::memcpy(&dst[i], &bits, 4);
+        }
+        return true;
+    }
+
+    if (src[0] != predicted || size < 4)
+        return false;
+
+    const int order = src[1];
+    const int shift = src[2];
+    const int k = src[3];
+    if (order > max_order || shift > 24 || k > 30)
+        return false;
+
+    detail::BitReader in{src + 4, size - 4};
+    for (auto i = 0; i < numSamples; i++)
+    {
+        std::uint32_t u = 0;
+        if (!in.rice(k, u))
+            return false;
+
+        const auto o = i < order ? i : order;
+        const auto x =
+            detail::unzigzag(u) +
+            (std::int64_t)detail::predict(q, i, o);
+
+        // only corrupt data leaves the fixed-point range
+        if (x < -16777216 || x > 16777216)
+            return false;
+        q[i] = (std::int32_t)x;
+    }
+
+    // exact, shifted values stay below 2^24 and the scale is a power of two
+    const auto scale = std::ldexp(1.0f, shift - 23);
+    for (auto i = 0; i < numSamples; i++)
+        dst[i] = (float)q[i] * scale;
+    return true;
+}
+
+inline void writeHeader(std::uint8_t *dst, const Header &h)
+{
+    detail::put32(dst, fourcc);
+    detail::put16(dst + 4, (std::uint32_t)version);
+    detail::put16(dst + 6, (std::uint32_t)h.channels);
+    detail::put32(dst + 8, (std::uint32_t)h.samples);
+    detail::put32(dst + 12, (std::uint32_t)h.sample_rate);
+    detail::put64(dst + 16, (std::uint64_t)h.timecode);
+}
+
+inline void setChannelSize(std::uint8_t *packet, int channel,
+                           std::size_t size)
+{
+    detail::put32(packet + header_bytes + (std::size_t)channel * 4,
+                  (std::uint32_t)size);
+}
+
+inline std::size_t getChannelSize(const std::uint8_t *packet, int channel)
+{
+    return detail::get32(packet + header_bytes + (std::size_t)channel * 4);
+}
+
+// false if src is not a packet or its size table does not add up
+inline bool readHeader(const std::uint8_t *src, std::size_t size, Header &h)
+{
+    if (size < header_bytes || detail::get32(src) != fourcc ||
+        detail::get16(src + 4) != (std::uint32_t)version)
+        return false;
+
+    h.channels = (int)detail::get16(src + 6);
+    h.samples = (int)detail::get32(src + 8);
+    h.sample_rate = (int)detail::get32(src + 12);
+    h.timecode = (std::int64_t)detail::get64(src + 16);
+    if (h.channels < 1 || h.channels > max_channels || h.samples < 1 ||
+        h.samples > max_samples || h.sample_rate <= 0 ||
+        size < headerBytes(h.channels))
+        return false;
+
+    auto total = headerBytes(h.channels);
+    for (auto c = 0; c < h.channels; c++)
+        total += getChannelSize(src, c);
+    return total == size;
+}
+
+// packet as metadata element into dst, which holds maxXmlBytes(size)
+inline std::size_t format(const std::uint8_t *src, std::size_t size,
+                          char *dst)
+{
+    static constexpr char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    auto p = dst;
+    for (auto t = open_tag; *t;)
+        *p++ = *t++;
+
+    std::size_t i = 0;
+    for (; i + 3 <= size; i += 3)
+    {
+        const auto v = (std::uint32_t)src[i] << 16 |
+                       (std::uint32_t)src[i + 1] << 8 | src[i + 2];
+        *p++ = alphabet[v >> 18];
+        *p++ = alphabet[(v >> 12) & 63];
+        *p++ = alphabet[(v >> 6) & 63];
+        *p++ = alphabet[v & 63];
+    }
+    if (i < size)
+    {
+        const auto two = i + 1 < size;
+        const auto v = (std::uint32_t)src[i] << 16 |
+                       (two ? (std::uint32_t)src[i + 1] << 8 : 0u);
+        *p++ = alphabet[v >> 18];
+        *p++ = alphabet[(v >> 12) & 63];
+        *p++ = two ? alphabet[(v >> 6) & 63] : '=';
+        *p++ = '=';
+    }
+
+    for (auto t = close_tag; *t;)
+        *p++ = *t++;
+    *p = '\0';
+    return (std::size_t)(p - dst);
+}
+
+// packet bytes of a metadata element into dst of capacity bytes, false if
+// xml is not one or it does not fit
+inline bool parse(const char *xml, std::uint8_t *dst, std::size_t capacity,
+                  std::size_t &size)
+{
+    if (xml == nullptr || std::strncmp(xml, tag, std::strlen(tag)) != 0)
+        return false;
+
+    auto p = std::strchr(xml, '>');
+    if (p == nullptr)
+        return false;
+    p++;
+
+    std::uint32_t v = 0;
+    auto bits = 0;
+    size = 0;
+    for (; *p != '\0' && *p != '<' && *p != '='; p++)
+    {
+        const auto ch = *p;
+        const auto d = ch >= 'A' && ch <= 'Z'   ? ch - 'A'
+                       : ch >= 'a' && ch <= 'z' ? ch - 'a' + 26
+                       : ch >= '0' && ch <= '9' ? ch - '0' + 52
+                       : ch == '+'              ? 62
+                       : ch == '/'              ? 63
+                                                : -1;
+        if (d < 0)
+            continue; // whitespace
+
+        v = v << 6 | (std::uint32_t)d;
+        bits += 6;
+        if (bits >= 8)
+        {
+            bits -= 8;
+            if (size == capacity)
+                return false;
+            dst[size++] = (std::uint8_t)(v >> bits);
+        }
+    }
+    return true;
+}
+} // namespace LosslessCodec
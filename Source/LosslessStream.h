@@ -0,0 +1,629 @@
+#pragma once
+#include <JuceHeader.h>
+#include <Processing.NDI.Lib.h>
+
+#include "AudioThreadGuard.h"
+#include "LosslessCodec.h"
+#include "SplitStreams.h"
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <memory>
+
+// coded size and CPU time of one side of codec=lossless, totals since the
+// stream started, any thread reads
+class LosslessStats
+{
+  public:
+    struct Totals
+    {
+        double ratio = 0.0;  // bytes sent per float byte, 0 before any
+        double cpu_us = 0.0; // per channel and second of audio
+        int64 dropped = 0;   // blocks or packets lost
+    };
+
+    void add(int channels, int samples, int sampleRate, std::size_t coded,
+             int64 ticks)
+    {
+        raw_bytes.fetch_add((int64)channels * samples * 4,
+                            std::memory_order_relaxed);
+        coded_bytes.fetch_add((int64)coded, std::memory_order_relaxed);
+        cpu_ticks.fetch_add(ticks, std::memory_order_relaxed);
+        audio_us.fetch_add((int64)channels * samples * 1000000 / sampleRate,
+                           std::memory_order_relaxed);
+    }
+
+    void drop()
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void reset()
+    {
+        raw_bytes = 0;
+        coded_bytes = 0;
+        cpu_ticks = 0;
+        audio_us = 0;
+        dropped = 0;
+    }
+
+    Totals get() const
+    {
+        Totals t{};
+        const auto raw = raw_bytes.load(std::memory_order_relaxed);
+        const auto audio = audio_us.load(std::memory_order_relaxed);
+        if (raw > 0)
+            t.ratio = (double)coded_bytes.load(std::memory_order_relaxed) /
+                      (double)raw;
+        if (audio > 0)
+            t.cpu_us = Time::highResolutionTicksToSeconds(
+                           cpu_ticks.load(std::memory_order_relaxed)) *
+                       1.0e12 / (double)audio;
+        t.dropped = dropped.load(std::memory_order_relaxed);
+        return t;
+    }
+
+  private:
+    std::atomic<int64> raw_bytes{0};
+    std::atomic<int64> coded_bytes{0};
+    std::atomic<int64> cpu_ticks{0};
+    std::atomic<int64> audio_us{0}; // channels times duration
+    std::atomic<int64> dropped{0};
+};
+
+// threads shared by all instances, channel groups of one block are coded in
+// parallel on them. Use through SharedResourcePointer<LosslessPool>
+class LosslessPool
+{
+  public:
+    static constexpr int max_threads = 8;
+    static constexpr int min_group = 8; // channels
+
+    LosslessPool()
+        : pool(jlimit(1, max_threads, SystemStats::getNumCpus() - 1))
+    {
+    }
+
+    int getMaxGroups() const
+    {
+        return pool.getNumThreads() + 1;
+    }
+
+    int getNumGroups(int numChannels) const
+    {
+        return jlimit(1, getMaxGroups(),
+                      (numChannels + min_group - 1) / min_group);
+    }
+
+    // first channel of group g, getGroupFirst(n, groups, groups) == n
+    static int getGroupFirst(int numChannels, int groups, int g)
+    {
+        return numChannels * g / groups;
+    }
+
+    // job(g) for every group, the calling thread takes group 0. Returns
+    // when all of them are done.
+    template <typename F>
+    void run(int groups, F &&job)
+    {
+        std::atomic<int> left{groups - 1};
+        WaitableEvent done{};
+        for (auto g = 1; g < groups; g++)
+            pool.addJob(
+                [&job, &left, &done, g]
+                {
+                    job(g);
+                    if (left.fetch_sub(1) == 1)
+                        done.signal();
+                });
+
+        job(0);
+        if (groups > 1)
+            done.wait();
+    }
+
+  private:
+    ThreadPool pool;
+};
+
+// send side of codec=lossless. The audio thread queues converted blocks, the
+// encoder thread codes their channel groups in parallel on the pool and
+// hands each block as metadata element to the send function, or as float
+// audio frame to send_audio when the element would not be smaller. Blocks go
+// out on their own source getSourceName(name), receivers opt in by
+// connecting to it, the plain source keeps its audio frames.
+class LosslessSender : private Thread
+{
+  public:
+    static constexpr int num_slots = 8;
+    static constexpr int poll_ms = 1; // encoder, while no block is pending
+
+    // back to elements after this many blocks in a row that came out
+    // smaller, so material at the edge does not switch every block
+    static constexpr int return_blocks = 50;
+
+    using Send = std::function<void(const char *xml, int64 timecode)>;
+    using SendAudio = std::function<void(const NDIlib_audio_frame_v2_t &)>;
+
+    LosslessSender(Send s, SendAudio a)
+        : Thread("NDI lossless encoder"), send(std::move(s)),
+          send_audio(std::move(a))
+    {
+    }
+
+    // "MACHINE (Sender)" -> "MACHINE (Sender.lossless)"
+    static String getSourceName(const String &name)
+    {
+        if (name.endsWithChar(')'))
+            return name.dropLastCharacters(1) + ".lossless)";
+        return name + ".lossless";
+    }
+
+    ~LosslessSender() override
+    {
+        prepare(0, 0);
+    }
+
+    // waits for the encoder, so not under a lock the send function takes or
+    // one held while waiting for it. 0 channels stops it and frees buffers.
+    void prepare(int numChannels, int maxSamples)
+    {
+        numChannels = jlimit(0, LosslessCodec::max_channels, numChannels);
+        maxSamples = jlimit(0, LosslessCodec::max_samples, maxSamples);
+        if (numChannels == channels && maxSamples == max_samples)
+            return;
+
+        stopThread(5000);
+
+        const GenericScopedLock<decltype(buffer_lock)> lock{buffer_lock};
+        channels = numChannels;
+        max_samples = maxSamples;
+        fifo.reset();
+        stats.reset();
+        elements = true;
+        smaller_blocks = 0;
+
+        if (channels == 0 || max_samples == 0)
+        {
+            audio.free();
+            coded.free();
+            packet.free();
+            xml.free();
+            scratch.free();
+            return;
+        }
+
+        const auto packet_bytes =
+            LosslessCodec::maxPacketBytes(channels, max_samples);
+        audio.calloc((size_t)num_slots * (size_t)channels *
+                     (size_t)max_samples);
+        coded.calloc((size_t)channels *
+                     LosslessCodec::maxChannelBytes(max_samples));
+        packet.calloc(packet_bytes);
+        xml.calloc(LosslessCodec::maxXmlBytes(packet_bytes));
+        scratch.calloc((size_t)pool->getMaxGroups() * (size_t)max_samples);
+
+        startThread(Thread::Priority::high);
+    }
+
+    // audio thread, planar block. Dropped and counted while the encoder is
+    // behind or being prepared.
+    void push(const float *planar, int numChannels, int numSamples,
+              int sampleRate, int64 timecode)
+    {
+        const GenericScopedTryLock<decltype(buffer_lock)> lock{buffer_lock};
+        if (!lock.isLocked() || channels == 0)
+        {
+            stats.drop();
+            return;
+        }
+        if (numChannels <= 0 || numChannels > channels ||
+            numSamples > max_samples)
+            return;
+
+        int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+        fifo.prepareToWrite(1, start1, size1, start2, size2);
+        if (size1 == 0)
+        {
+            stats.drop();
+            return;
+        }
+
+        std::memcpy(getSlotAudio(start1), planar,
+                    (size_t)numChannels * (size_t)numSamples *
+                        sizeof(float));
+        slots[(size_t)start1] = {numChannels, numSamples, sampleRate,
+                                 timecode};
+        fifo.finishedWrite(1);
+
+        // the encoder polls for this, notify() would take the event's lock
+        pending.store(true, std::memory_order_release);
+    }
+
+    LosslessStats::Totals getStats() const
+    {
+        return stats.get();
+    }
+
+  private:
+    struct Slot
+    {
+        int channels = 0;
+        int samples = 0;
+        int sample_rate = 0;
+        int64 timecode = 0;
+    };
+
+    float *getSlotAudio(int slot)
+    {
+        return audio.get() +
+               (size_t)slot * (size_t)channels * (size_t)max_samples;
+    }
+
+    void run() override
+    {
+        while (!threadShouldExit())
+        {
+            if (!pending.exchange(false, std::memory_order_acquire))
+            {
+                wait(poll_ms);
+                continue;
+            }
+
+            while (!threadShouldExit())
+            {
+                int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+                fifo.prepareToRead(1, start1, size1, start2, size2);
+                if (size1 == 0)
+                    break;
+
+                encode(start1);
+                fifo.finishedRead(1);
+            }
+        }
+    }
+
+    void encode(int slot)
+    {
+        const auto &block = slots[(size_t)slot];
+        const auto n = block.samples;
+        const auto src = getSlotAudio(slot);
+        const auto stride = LosslessCodec::maxChannelBytes(n);
+        const auto groups = pool->getNumGroups(block.channels);
+        std::atomic<int64> ticks{0};
+
+        // each group writes its own channels and size table entries
+        pool->run(groups,
+                  [&](int g)
+                  {
+                      const auto begin = Time::getHighResolutionTicks();
+                      auto q = scratch.get() + (size_t)g * (size_t)max_samples;
+                      const auto first = LosslessPool::getGroupFirst(
+                          block.channels, groups, g);
+                      const auto last = LosslessPool::getGroupFirst(
+                          block.channels, groups, g + 1);
+                      for (auto c = first; c < last; c++)
+                      {
+                          const auto size = LosslessCodec::encodeChannel(
+                              src + (size_t)c * (size_t)n, n, q,
+                              coded.get() + (size_t)c * stride);
+                          LosslessCodec::setChannelSize(packet.get(), c, size);
+                      }
+                      ticks.fetch_add(Time::getHighResolutionTicks() - begin);
+                  });
+
+        LosslessCodec::writeHeader(packet.get(), {block.channels, n,
+                                                  block.sample_rate,
+                                                  block.timecode});
+        auto size = LosslessCodec::headerBytes(block.channels);
+        for (auto c = 0; c < block.channels; c++)
+        {
+            const auto channel_size =
+                LosslessCodec::getChannelSize(packet.get(), c);
+            std::memcpy(packet.get() + size, coded.get() + (size_t)c * stride,
+                        channel_size);
+            size += channel_size;
+        }
+
+        // base64 adds a third, an element only pays while the packet is
+        // well under the float block
+        const auto xml_size = LosslessCodec::format(packet.get(), size,
+                                                    xml.get());
+        const auto raw_size = (size_t)block.channels * (size_t)n *
+                              sizeof(float);
+        if (xml_size >= raw_size)
+        {
+            elements = false;
+            smaller_blocks = 0;
+        }
+        else if (!elements && ++smaller_blocks >= return_blocks)
+        {
+            elements = true;
+        }
+
+        stats.add(block.channels, n, block.sample_rate,
+                  elements ? xml_size : raw_size, ticks.load());
+        if (elements)
+        {
+            send(xml.get(), block.timecode);
+            return;
+        }
+
+        NDIlib_audio_frame_v2_t frame{};
+        frame.sample_rate = block.sample_rate;
+        frame.no_channels = block.channels;
+        frame.no_samples = n;
+        frame.timecode = block.timecode;
+        frame.p_data = src;
+        frame.channel_stride_in_bytes = n * (int)sizeof(float);
+        send_audio(frame);
+    }
+
+    Send send;
+    SendAudio send_audio;
+    SharedResourcePointer<LosslessPool> pool{};
+    LosslessStats stats{};
+
+    // set by push, taken by the encoder
+    std::atomic<bool> pending{false};
+
+    // sizes and buffers change only with the encoder stopped and the audio
+    // thread locked out
+    AudioThreadGuard::Lock<SpinLock> buffer_lock{};
+    int channels{0};
+    int max_samples{0};
+    AbstractFifo fifo{num_slots};
+    std::array<Slot, num_slots> slots{};
+    HeapBlock<float> audio{};
+
+    // encoder thread
+    HeapBlock<uint8> coded{}; // maxChannelBytes apart
+    HeapBlock<uint8> packet{};
+    HeapBlock<char> xml{};
+    HeapBlock<int32> scratch{}; // per group
+    bool elements{true};         // else float audio frames
+    int smaller_blocks{0};       // in a row while sending frames
+};
+
+// receive side, packets of the primary source are decoded on the worker
+// thread into a FIFO the audio thread plays instead of the frame-sync
+class LosslessReceiver
+{
+  public:
+    static constexpr int buffer_ms = 300;
+    static constexpr int timeout_ms = 500; // stream counts as gone after
+
+    // worker thread, false if xml is not a packet. The FIFO is replaced
+    // under audio_lock when the stream format changes, a full one drops the
+    // packet.
+    template <typename Lock>
+    bool receive(const char *xml, int maxBlock, Lock &audio_lock)
+    {
+        if (xml == nullptr ||
+            std::strncmp(xml, LosslessCodec::tag,
+                         std::strlen(LosslessCodec::tag)) != 0)
+            return false;
+
+        const auto capacity = std::strlen(xml) / 4 * 3 + 3;
+        if (capacity > packet_capacity)
+        {
+            packet.realloc(capacity);
+            packet_capacity = capacity;
+        }
+
+        size_t size = 0;
+        LosslessCodec::Header h{};
+        if (!LosslessCodec::parse(xml, packet.get(), capacity, size) ||
+            !LosslessCodec::readHeader(packet.get(), size, h))
+        {
+            stats.drop();
+            return true;
+        }
+
+        if (!stream || stream->channels != h.channels ||
+            stream->sample_rate != h.sample_rate ||
+            stream->max_block < maxBlock ||
+            stream->fifo.getTotalSize() <= h.samples)
+        {
+            auto next = std::make_unique<Stream>(h, maxBlock);
+            audio_lock.enter();
+            std::swap(next, stream);
+            audio_lock.exit();
+        }
+
+        const auto decoded_size = (size_t)h.channels * (size_t)h.samples;
+        if (decoded_size > decoded_capacity)
+        {
+            decoded.realloc(decoded_size);
+            decoded_capacity = decoded_size;
+        }
+        if ((size_t)h.samples > scratch_samples)
+        {
+            scratch.realloc((size_t)pool->getMaxGroups() * (size_t)h.samples);
+            scratch_samples = (size_t)h.samples;
+        }
+
+        std::array<size_t, LosslessCodec::max_channels + 1> offsets{};
+        offsets[0] = LosslessCodec::headerBytes(h.channels);
+        for (auto c = 0; c < h.channels; c++)
+            offsets[(size_t)c + 1] = offsets[(size_t)c] +
+                                     LosslessCodec::getChannelSize(
+                                         packet.get(), c);
+
+        const auto groups = pool->getNumGroups(h.channels);
+        std::atomic<int64> ticks{0};
+        std::atomic<bool> ok{true};
+        pool->run(groups,
+                  [&](int g)
+                  {
+                      const auto begin = Time::getHighResolutionTicks();
+                      auto q = scratch.get() + (size_t)g * scratch_samples;
+                      const auto first =
+                          LosslessPool::getGroupFirst(h.channels, groups, g);
+                      const auto last = LosslessPool::getGroupFirst(
+                          h.channels, groups, g + 1);
+                      for (auto c = first; c < last; c++)
+                      {
+                          const auto at = offsets[(size_t)c];
+                          if (!LosslessCodec::decodeChannel(
+                                  packet.get() + at,
+                                  offsets[(size_t)c + 1] - at,
+                                  decoded.get() +
+                                      (size_t)c * (size_t)h.samples,
+                                  h.samples, q))
+                              ok = false;
+                      }
+                      ticks.fetch_add(Time::getHighResolutionTicks() - begin);
+                  });
+
+        auto &s = *stream;
+        int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+        s.fifo.prepareToWrite(h.samples, start1, size1, start2, size2);
+        if (!ok || size1 + size2 < h.samples)
+        {
+            stats.drop();
+            return true;
+        }
+
+        for (auto c = 0; c < h.channels; c++)
+        {
+            auto src = decoded.get() + (size_t)c * (size_t)h.samples;
+            auto dst = s.data.get() + (size_t)c * (size_t)s.capacity;
+            std::memcpy(dst + start1, src, (size_t)size1 * sizeof(float));
+            std::memcpy(dst + start2, src + size1,
+                        (size_t)size2 * sizeof(float));
+        }
+        s.fifo.finishedWrite(h.samples);
+
+        stats.add(h.channels, h.samples, h.sample_rate, size, ticks.load());
+        last_ms.store(Time::getMillisecondCounter(), std::memory_order_relaxed);
+        return true;
+    }
+
+    // worker thread, packets arrived lately
+    bool isReceiving() const
+    {
+        return stream != nullptr && isRecent();
+    }
+
+    // under audio_lock with the worker held off, e.g. on reconnect
+    void reset()
+    {
+        stream.reset();
+        stats.reset();
+    }
+
+    // audio thread, packets at sampleRate arrived lately
+    bool isActive(int sampleRate) const
+    {
+        return stream != nullptr && stream->sample_rate == sampleRate &&
+               isRecent();
+    }
+
+    // audio thread, samples queued
+    int getReady() const
+    {
+        return stream != nullptr ? stream->fifo.getNumReady() : 0;
+    }
+
+    // audio thread after isActive, next numSamples as frame. Silence while
+    // it waits for a packet more than the block, again after running dry.
+    // The frame holds at most max_block + 1 samples, a sample more for the
+    // jitter controller; callers read no_samples, never what they asked for.
+    const NDIlib_audio_frame_v2_t &read(int numSamples)
+    {
+        auto &s = *stream;
+        numSamples = jlimit(0, s.max_block + 1, numSamples);
+
+        const auto ready = s.fifo.getNumReady();
+        if (!s.primed)
+            s.primed = ready >= numSamples + s.packet_samples;
+        const auto n = s.primed ? jmin(ready, numSamples) : 0;
+        if (n < numSamples)
+            s.primed = false;
+
+        int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+        s.fifo.prepareToRead(n, start1, size1, start2, size2);
+        for (auto c = 0; c < s.channels; c++)
+        {
+            auto src = s.data.get() + (size_t)c * (size_t)s.capacity;
+            auto dst = s.block.get() + (size_t)c * (size_t)numSamples;
+            std::memcpy(dst, src + start1, (size_t)size1 * sizeof(float));
+            std::memcpy(dst + size1, src + start2,
+                        (size_t)size2 * sizeof(float));
+            FloatVectorOperations::clear(dst + n, numSamples - n);
+        }
+        s.fifo.finishedRead(n);
+
+        s.frame.no_samples = numSamples;
+        s.frame.channel_stride_in_bytes =
+            numSamples * static_cast<int>(sizeof(float));
+        s.frame.timecode =
+            s.first_timecode +
+            SplitStreams::toTimecode(s.read_total, s.sample_rate);
+        s.read_total += n;
+        return s.frame;
+    }
+
+    LosslessStats::Totals getStats() const
+    {
+        return stats.get();
+    }
+
+  private:
+    struct Stream
+    {
+        Stream(const LosslessCodec::Header &h, int maxBlock)
+            : channels(h.channels), sample_rate(h.sample_rate),
+              max_block(maxBlock), packet_samples(h.samples),
+              capacity(jmax(4 * h.samples, 4 * maxBlock,
+                            h.sample_rate * buffer_ms / 1000)),
+              fifo(capacity), first_timecode(h.timecode)
+        {
+            data.calloc((size_t)channels * (size_t)capacity);
+            block.calloc((size_t)channels * (size_t)(max_block + 1));
+            frame.sample_rate = sample_rate;
+            frame.no_channels = channels;
+            frame.p_data = block.get();
+            frame.timestamp = NDIlib_recv_timestamp_undefined;
+        }
+
+        const int channels;
+        const int sample_rate;
+        const int max_block;
+        const int packet_samples;
+        const int capacity;
+        AbstractFifo fifo;
+        HeapBlock<float> data{}; // capacity per channel
+
+        // audio thread
+        const int64 first_timecode;
+        int64 read_total{0};
+        bool primed{false};
+        HeapBlock<float> block{}; // max_block + 1 per channel
+        NDIlib_audio_frame_v2_t frame{};
+    };
+
+    bool isRecent() const
+    {
+        return (int)(Time::getMillisecondCounter() -
+                     last_ms.load(std::memory_order_relaxed)) < timeout_ms;
+    }
+
+    SharedResourcePointer<LosslessPool> pool{};
+    LosslessStats stats{};
+    std::atomic<uint32> last_ms{0};
+
+    // replaced by worker under audio_lock, read by both
+    std::unique_ptr<Stream> stream{};
+
+    // worker thread
+    HeapBlock<uint8> packet{};
+    size_t packet_capacity{0};
+    HeapBlock<float> decoded{};
+    size_t decoded_capacity{0};
+    HeapBlock<int32> scratch{}; // per group
+    size_t scratch_samples{0};
+};
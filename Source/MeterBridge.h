@@ -0,0 +1,120 @@
+#pragma once
+#include <JuceHeader.h>
+
+#include "LevelMeter.h"
+
+// one thin column per channel, rms filled and peak as a line
+// polls its LevelMeter at display rate and repaints only columns whose
+// pixel height changed
+class MeterBridge : public Component, private Timer
+{
+  public:
+    explicit MeterBridge(const LevelMeter &m) : meter(m)
+    {
+        setOpaque(true);
+        startTimerHz(30);
+    }
+
+    void paint(Graphics &g) override
+    {
+        g.fillAll(Colour(0xff0e0e0e));
+
+        auto clip = g.getClipBounds();
+        for (auto i = 0; i < channels; i++)
+        {
+            auto column = getColumn(i);
+            if (!column.intersects(clip))
+                continue;
+
+            auto c = (size_t)i;
+            g.setColour(Colour(0xff1c1c1c));
+            g.fillRect(column);
+
+            g.setColour(Colour(0xff6257ff));
+            g.fillRect(column.withTop(column.getBottom() - rms_px[c]));
+
+            if (peak_px[c] > 0)
+            {
+                g.setColour(peak[c] >= 1.0f ? Colours::red : Colours::grey);
+                g.fillRect(column.getX(), column.getBottom() - peak_px[c],
+                           column.getWidth(), 1);
+            }
+        }
+    }
+
+    void resized() override
+    {
+        peak_px.fill(0);
+        rms_px.fill(0);
+        repaint();
+    }
+
+  private:
+    static constexpr auto floor_db = -60.0f;
+    static constexpr auto decay = 0.8f; // per tick, about 60 dB/s
+
+    void timerCallback() override
+    {
+        auto fresh = meter.read(snapshot);
+
+        if (snapshot.channels != channels)
+        {
+            channels = snapshot.channels;
+            peak.fill(0.0f);
+            rms.fill(0.0f);
+            peak_px.fill(0);
+            rms_px.fill(0);
+            repaint();
+        }
+
+        for (auto i = 0; i < channels; i++)
+        {
+            auto c = (size_t)i;
+            peak[c] *= decay;
+            rms[c] *= decay;
+            if (fresh)
+            {
+                peak[c] = jmax(peak[c], snapshot.peak[c]);
+                rms[c] = jmax(rms[c], snapshot.rms[c]);
+            }
+
+            auto column = getColumn(i);
+            auto p = toPixels(peak[c], column.getHeight());
+            auto r = toPixels(rms[c], column.getHeight());
+            if (p != peak_px[c] || r != rms_px[c])
+            {
+                peak_px[c] = p;
+                rms_px[c] = r;
+                repaint(column);
+            }
+        }
+    }
+
+    Rectangle<int> getColumn(int i) const
+    {
+        auto w = getWidth();
+        auto x0 = channels > 0 ? w * i / channels : 0;
+        auto x1 = channels > 0 ? w * (i + 1) / channels : 0;
+        // 1 px gap when columns are wide enough
+        return {x0, 0, jmax(1, x1 - x0 - (x1 - x0 > 3 ? 1 : 0)),
+                getHeight()};
+    }
+
+    static int toPixels(float level, int height)
+    {
+        auto db = Decibels::gainToDecibels(level, floor_db);
+        return roundToInt(jlimit(0.0f, 1.0f, 1.0f - db / floor_db) *
+                          (float)height);
+    }
+
+    const LevelMeter &meter;
+    LevelMeter::Snapshot snapshot{};
+    int channels = 0;
+
+    std::array<float, LevelMeter::max_channels> peak{};
+    std::array<float, LevelMeter::max_channels> rms{};
+    std::array<int, LevelMeter::max_channels> peak_px{};
+    std::array<int, LevelMeter::max_channels> rms_px{};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MeterBridge)
+};
@@ -0,0 +1,310 @@
+#pragma once
+#include <JuceHeader.h>
+
+#include "MetricsLayout.h"
+
+#include <array>
+#include <atomic>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// audio thread side of the metrics export, plain relaxed counters the
+// publisher reads without any lock the audio thread takes
+class BlockMetrics
+{
+  public:
+    // log scale in us, 4 buckets per octave, the last one takes the rest
+    static constexpr int num_buckets = 96;
+    static constexpr int drift_window_s = 10;
+
+    struct Times
+    {
+        int64 p50 = 0;
+        int64 p99 = 0;
+        int64 max = 0;
+    };
+
+    // times its own lifetime as one audio callback
+    class Scope
+    {
+      public:
+        explicit Scope(BlockMetrics &m) noexcept
+            : metrics(m), begin(Time::getHighResolutionTicks())
+        {
+        }
+
+        ~Scope()
+        {
+            metrics.record(Time::getHighResolutionTicks() - begin);
+        }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+      private:
+        BlockMetrics &metrics;
+        int64 begin;
+    };
+
+    // before playback, not concurrent with audio thread
+    void prepare(double sampleRate, int samplesPerBlock)
+    {
+        sample_rate.store((int)sampleRate, std::memory_order_relaxed);
+        block_size.store(samplesPerBlock, std::memory_order_relaxed);
+        blocks.store(0, std::memory_order_relaxed);
+        dropped.store(0, std::memory_order_relaxed);
+        drift_source = nullptr;
+    }
+
+    // audio thread, callback skipped without processing
+    void drop()
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // audio thread, frame-sync queued depth before pulling pull samples for
+    // numSamples of output. Samples that arrived in between against the
+    // samples played is the source clock against ours.
+    void recvPull(const void *source, int depth, int pull, int numSamples,
+                  int sampleRate)
+    {
+        if (source != drift_source)
+        {
+            drift_source = source;
+            drift_left = -1;
+            drift_arrived = 0;
+            drift_played = 0;
+            drift_ppb.store(0, std::memory_order_relaxed);
+        }
+
+        if (drift_left >= 0)
+        {
+            drift_arrived += depth - drift_left;
+            drift_played += numSamples;
+        }
+        drift_left = jmax(0, depth - pull);
+        queue.store(depth, std::memory_order_relaxed);
+
+        if (drift_played >= (int64)sampleRate * drift_window_s)
+        {
+            drift_ppb.store((drift_arrived - drift_played) * 1000000000 /
+                                drift_played,
+                            std::memory_order_relaxed);
+            drift_arrived = 0;
+            drift_played = 0;
+        }
+    }
+
+    int getSampleRate() const
+    {
+        return sample_rate.load(std::memory_order_relaxed);
+    }
+
+    int getBlockSize() const
+    {
+        return block_size.load(std::memory_order_relaxed);
+    }
+
+    int64 getBlocks() const
+    {
+        return blocks.load(std::memory_order_relaxed);
+    }
+
+    int64 getDropped() const
+    {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+    int getQueue() const
+    {
+        return queue.load(std::memory_order_relaxed);
+    }
+
+    int64 getDriftPpb() const
+    {
+        return drift_ppb.load(std::memory_order_relaxed);
+    }
+
+    // publisher thread only, block times since the previous call
+    Times takeTimes()
+    {
+        std::array<uint32, num_buckets> window{};
+        uint32 total = 0;
+        for (size_t i = 0; i < (size_t)num_buckets; i++)
+        {
+            auto n = counts[i].load(std::memory_order_relaxed);
+            window[i] = n - taken[i];
+            taken[i] = n;
+            total += window[i];
+        }
+
+        Times t{};
+        t.max = max_us.exchange(0, std::memory_order_relaxed);
+        if (total == 0)
+            return t;
+
+        auto percentile = [&window, total](uint32 p)
+        {
+            uint64 sum = 0;
+            for (auto i = 0; i < num_buckets; i++)
+            {
+                sum += window[(size_t)i];
+                if (sum * 100 >= (uint64)total * p)
+                    return lowerBound(i + 1);
+            }
+            return lowerBound(num_buckets);
+        };
+        t.p50 = percentile(50);
+        t.p99 = percentile(99);
+        return t;
+    }
+
+  private:
+    void record(int64 ticks)
+    {
+        const auto us = (int64)(Time::highResolutionTicksToSeconds(ticks) *
+                                1.0e6);
+        counts[(size_t)bucket(us)].fetch_add(1, std::memory_order_relaxed);
+        if (us > max_us.load(std::memory_order_relaxed))
+            max_us.store(us, std::memory_order_relaxed);
+        blocks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static int bucket(int64 us)
+    {
+        if (us < 4)
+            return (int)jmax((int64)0, us);
+
+        const auto v = (uint32)jmin(us, (int64)0x7fffffff);
+        const auto octave = findHighestSetBit(v);
+        const auto i = (octave - 1) * 4 + (int)((v >> (octave - 2)) & 3);
+        return jmin(i, num_buckets - 1);
+    }
+
+    // smallest us in bucket i
+    static int64 lowerBound(int i)
+    {
+        if (i < 4)
+            return i;
+        return (int64)(4 + i % 4) << (i / 4 - 1);
+    }
+
+    std::atomic<int> sample_rate{0};
+    std::atomic<int> block_size{0};
+    std::atomic<int64> blocks{0};
+    std::atomic<int64> dropped{0};
+    std::atomic<int64> max_us{0};
+    std::array<std::atomic<uint32>, num_buckets> counts{};
+    std::array<uint32, num_buckets> taken{}; // publisher
+
+    // drift, audio thread except the shared results
+    const void *drift_source = nullptr;
+    int drift_left{-1};
+    int64 drift_arrived{0};
+    int64 drift_played{0};
+    std::atomic<int> queue{0};
+    std::atomic<int64> drift_ppb{0};
+};
+
+// owner of the shared memory segment of one instance, see MetricsLayout.h
+// one writer thread. Does nothing on Windows or when shm_open fails.
+class MetricsExport
+{
+  public:
+    ~MetricsExport()
+    {
+        close();
+    }
+
+    bool open(int instance)
+    {
+#ifndef _WIN32
+        close();
+
+        name = MetricsLayout::name_prefix + std::to_string(getpid()) + "." +
+               std::to_string(instance);
+        auto fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+        if (fd < 0)
+            return false;
+
+        void *p = MAP_FAILED;
+        if (ftruncate(fd, sizeof(MetricsLayout::Segment)) == 0)
+            p = mmap(nullptr, sizeof(MetricsLayout::Segment),
+                     PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+
+        if (p == MAP_FAILED)
+        {
+            shm_unlink(name.c_str());
+            return false;
+        }
+
+        // zero filled by ftruncate, atomics are valid as they are
+        segment = static_cast<MetricsLayout::Segment *>(p);
+        segment->version = MetricsLayout::version;
+        segment->value_count = MetricsLayout::num_values;
+        segment->pid = (uint32)getpid();
+        segment->instance = (uint32)instance;
+
+        // magic last, a reader that sees it sees the rest
+        std::atomic_thread_fence(std::memory_order_release);
+        segment->magic = MetricsLayout::magic;
+        return true;
+#else
+        (void)instance;
+        return false;
+#endif
+    }
+
+    void close()
+    {
+#ifndef _WIN32
+        if (segment == nullptr)
+            return;
+
+        munmap(segment, sizeof(MetricsLayout::Segment));
+        shm_unlink(name.c_str());
+        segment = nullptr;
+#endif
+    }
+
+    bool isOpen() const
+    {
+        return segment != nullptr;
+    }
+
+    // writer thread, fill(*this) sets values and names between the
+    // sequence bumps, readers see all of them or none
+    template <typename F>
+    void write(F &&fill)
+    {
+        if (segment == nullptr)
+            return;
+
+        MetricsLayout::beginWrite(*segment);
+        fill(*this);
+        set(MetricsLayout::updated_ms, Time::currentTimeMillis());
+        MetricsLayout::endWrite(*segment);
+    }
+
+    // only inside write()
+    void set(MetricsLayout::Value v, int64 x)
+    {
+        segment->values[v].store(x, std::memory_order_relaxed);
+    }
+
+    void setNames(const String &send, const String &recv)
+    {
+        send.copyToUTF8(segment->send_name, MetricsLayout::name_length);
+        recv.copyToUTF8(segment->recv_name, MetricsLayout::name_length);
+    }
+
+  private:
+    MetricsLayout::Segment *segment = nullptr;
+    std::string name{};
+};
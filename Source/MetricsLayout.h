@@ -0,0 +1,146 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// Health counters of one plugin instance in a POSIX shared memory segment
+// named /ndi_audio_io.<pid>.<instance>, instance being the id on the control
+// endpoint. Shared by the plugin (writer) and ndi_audio_io_metrics (reader),
+// no JUCE here.
+//
+// Versioning: version only changes when a field moves or changes meaning.
+// New values are appended to Value, a reader uses the first
+// min(value_count, its own num_values) and ignores the rest.
+//
+// Seqlock: the one writer makes sequence odd, stores, then makes it even
+// again. A reader copies between two loads of the same even sequence and
+// retries otherwise. Neither side waits for the other, a reader can not
+// hold up the writer or the audio thread behind it.
+namespace MetricsLayout
+{
+constexpr std::uint32_t magic = 0x4d41444e; // "NDAM"
+constexpr std::uint32_t version = 1;
+constexpr const char *name_prefix = "/ndi_audio_io.";
+constexpr int name_length = 128;
+
+// index into Segment::values, append only
+enum Value : int
+{
+    updated_ms,             // unix time of the last update
+    sample_rate,            // Hz, 0 before playback
+    block_size,             // largest host block, samples
+    latency_samples,        // reported to the host
+    blocks,                 // audio callbacks since prepare
+    dropped_blocks,         // of those, skipped while reconfiguring or loading
+    block_us_p50,           // processing time since the previous update, upper
+    block_us_p99,           //   bound of a bucket at most 25% wide
+    block_us_max,           //
+    send_on,                // 0 or 1
+    send_connections,       // receivers of the sender, -1 unknown
+    send_idle_ms,           // skipped for lack of receivers
+    recv_on,                // 0 or 1
+    recv_on_backup,         // 0 or 1
+    recv_queue_samples,     // frame-sync queue depth at the last pull
+    recv_target_ms,         // adaptive buffer target, -1 off
+    recv_underruns,         // since connecting
+    recv_concealed,         // dropouts concealed since connecting
+    recv_sync_delay,        // samples, -1 if not in a sync group
+    recv_drift_ppb,         // source clock against ours, parts per billion
+    send_lossless_permille, // codec=lossless, coded bytes per 1000 float
+    send_lossless_cpu_us,   //   encoder per channel and second of audio
+    send_lossless_dropped,  //   blocks the encoder could not take
+    recv_lossless_permille, // same for packets decoded from the source
+    recv_lossless_cpu_us,   //
+    recv_lossless_dropped,  //   full buffer or corrupt
+    num_values
+};
+
+constexpr const char *value_names[num_values] = {
+    "updated_ms",             "sample_rate",
+    "block_size",             "latency_samples",
+    "blocks",                 "dropped_blocks",
+    "block_us_p50",           "block_us_p99",
+    "block_us_max",           "send_on",
+    "send_connections",       "send_idle_ms",
+    "recv_on",                "recv_on_backup",
+    "recv_queue_samples",     "recv_target_ms",
+    "recv_underruns",         "recv_concealed",
+    "recv_sync_delay",        "recv_drift_ppb",
+    "send_lossless_permille", "send_lossless_cpu_us",
+    "send_lossless_dropped",  "recv_lossless_permille",
+    "recv_lossless_cpu_us",   "recv_lossless_dropped",
+};
+
+// names come first so appended values do not move them
+struct Segment
+{
+    // constant after creation
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t value_count; // values the writer has
+    std::uint32_t pid;
+    std::uint32_t instance;
+
+    std::atomic<std::uint32_t> sequence;
+    char send_name[name_length]; // sender name, without machine name
+    char recv_name[name_length]; // source the receiver asked for
+    std::atomic<std::int64_t> values[num_values];
+};
+
+// shared between processes, must not fall back to a lock
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free);
+static_assert(std::atomic<std::int64_t>::is_always_lock_free);
+
+struct Snapshot
+{
+    std::uint32_t sequence = 0;
+    int value_count = 0;
+    char send_name[name_length]{};
+    char recv_name[name_length]{};
+    std::int64_t values[num_values]{};
+};
+
+// writer, stores between begin and end are seen together
+inline void beginWrite(Segment &s)
+{
+    auto n = s.sequence.load(std::memory_order_relaxed);
+    s.sequence.store(n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+inline void endWrite(Segment &s)
+{
+    s.sequence.fetch_add(1, std::memory_order_release);
+}
+
+// reader, false if the writer kept overtaking the copy
+inline bool read(const Segment &s, Snapshot &dst, int attempts = 100)
+{
+    const auto n = s.value_count < (std::uint32_t)num_values
+                       ? (int)s.value_count
+                       : (int)num_values;
+
+    for (auto a = 0; a < attempts; a++)
+    {
+        auto before = s.sequence.load(std::memory_order_acquire);
+        if (before & 1u)
+            continue;
+
+        std::memcpy(dst.send_name, s.send_name, name_length);
+        std::memcpy(dst.recv_name, s.recv_name, name_length);
+        for (auto i = 0; i < n; i++)
+            dst.values[i] = s.values[i].load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.sequence.load(std::memory_order_relaxed) != before)
+            continue;
+
+        dst.send_name[name_length - 1] = 0;
+        dst.recv_name[name_length - 1] = 0;
+        dst.sequence = before;
+        dst.value_count = n;
+        return true;
+    }
+    return false;
+}
+} // namespace MetricsLayout
@@ -0,0 +1,284 @@
+#pragma once
+#include <JuceHeader.h>
+#include <Processing.NDI.Lib.h>
+
+#include <mutex>
+#include <vector>
+
+// receiver settings from receive options, default is audio only since the
+// plugin never uses video. Only audio only connections are pooled.
+struct NdiRecvProfile
+{
+    NDIlib_recv_bandwidth_e bandwidth = NDIlib_recv_bandwidth_audio_only;
+    NDIlib_recv_color_format_e color_format =
+        NDIlib_recv_color_format_UYVY_BGRA;
+    bool allow_video_fields = true;
+
+    // bandwidth=audio|lowest|highest, color=..., fields=on|off
+    static NdiRecvProfile fromOptions(const StringPairArray &options)
+    {
+        NdiRecvProfile p{};
+
+        auto bandwidth = options["bandwidth"];
+        if (bandwidth == "lowest")
+            p.bandwidth = NDIlib_recv_bandwidth_lowest;
+        else if (bandwidth == "highest")
+            p.bandwidth = NDIlib_recv_bandwidth_highest;
+
+        auto color = options["color"];
+        if (color == "bgrx")
+            p.color_format = NDIlib_recv_color_format_BGRX_BGRA;
+        else if (color == "rgbx")
+            p.color_format = NDIlib_recv_color_format_RGBX_RGBA;
+        else if (color == "uyvy_rgba")
+            p.color_format = NDIlib_recv_color_format_UYVY_RGBA;
+        else if (color == "fastest")
+            p.color_format = NDIlib_recv_color_format_fastest;
+        else if (color == "best")
+            p.color_format = NDIlib_recv_color_format_best;
+
+        p.allow_video_fields = options["fields"] != "off";
+        return p;
+    }
+
+    static NdiRecvProfile of(const NDIlib_recv_create_v3_t &create)
+    {
+        return {create.bandwidth, create.color_format,
+                create.allow_video_fields};
+    }
+
+    // color format and fields only apply to video
+    bool isAudioOnly() const
+    {
+        return bandwidth == NDIlib_recv_bandwidth_audio_only;
+    }
+
+    void applyTo(NDIlib_recv_create_v3_t &create) const
+    {
+        create.bandwidth = bandwidth;
+        create.color_format = color_format;
+        create.allow_video_fields = allow_video_fields;
+    }
+
+    bool operator==(const NdiRecvProfile &other) const
+    {
+        return bandwidth == other.bandwidth &&
+               color_format == other.color_format &&
+               allow_video_fields == other.allow_video_fields;
+    }
+
+    bool operator!=(const NdiRecvProfile &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+// receiver with its frame-sync, owned by processor or parked in pool
+struct NdiRecvConnection
+{
+    String name{};
+    NDIlib_recv_instance_t recv = nullptr;
+    NDIlib_framesync_instance_t framesync = nullptr;
+    NdiRecvProfile profile{};
+    uint32 last_used_ms = 0;
+};
+
+// LRU pool of live receivers for recently used sources, keyed on the source
+// switching back skips connect and frame-sync buffer fill. NDI fixes the
+// bandwidth when a receiver is created, a parked one can not be turned down
+// to audio only. So only audio only connections are parked, one that carries
+// video is closed on release instead of keeping its stream running.
+class NdiRecvPool
+{
+  public:
+    ~NdiRecvPool()
+    {
+        // clear() must run while NDI library is still loaded
+        jassert(pool.empty());
+    }
+
+    void setup(const NDIlib_v5 *lib, const NDIlib_metadata_frame_t *metadata)
+    {
+        p_NDILib = lib;
+        p_metadata = metadata;
+    }
+
+    void setLimits(int size, int idle_timeout_ms)
+    {
+        std::vector<NdiRecvConnection> evicted{};
+        {
+            std::scoped_lock lock{pool_mutex};
+            max_size = jmax(0, size);
+            idle_ms = jmax(0, idle_timeout_ms);
+            trim(evicted);
+        }
+        for (auto &&c : evicted)
+            close(c);
+    }
+
+    // promotes pooled connection for source or opens a new one, video
+    // profiles always open their own
+    NdiRecvConnection acquire(const NDIlib_recv_create_v3_t &create)
+    {
+        String name{create.source_to_connect_to.p_ndi_name};
+        auto profile = NdiRecvProfile::of(create);
+        if (profile.isAudioOnly())
+        {
+            std::scoped_lock lock{pool_mutex};
+            for (auto it = pool.begin(); it != pool.end(); ++it)
+            {
+                if (it->name == name)
+                {
+                    auto c = *it;
+                    c.profile = profile;
+                    pool.erase(it);
+                    hits++;
+                    return c;
+                }
+            }
+        }
+        misses++;
+        return open(create, profile);
+    }
+
+    // parks connection as most recently used, evicting least recently used
+    // and an older one of the same source
+    void release(NdiRecvConnection c)
+    {
+        if (c.recv == nullptr)
+            return;
+
+        if (max_size <= 0 || c.name.isEmpty() || !c.profile.isAudioOnly())
+        {
+            close(c);
+            return;
+        }
+
+        c.last_used_ms = Time::getMillisecondCounter();
+
+        std::vector<NdiRecvConnection> evicted{};
+        {
+            std::scoped_lock lock{pool_mutex};
+            for (auto it = pool.begin(); it != pool.end(); ++it)
+            {
+                if (it->name == c.name)
+                {
+                    evicted.push_back(*it);
+                    pool.erase(it);
+                    break;
+                }
+            }
+            pool.insert(pool.begin(), c);
+            trim(evicted);
+        }
+        for (auto &&e : evicted)
+            close(e);
+    }
+
+    // closes connections parked longer than idle timeout
+    void expire()
+    {
+        std::vector<NdiRecvConnection> evicted{};
+        {
+            std::scoped_lock lock{pool_mutex};
+            auto now = Time::getMillisecondCounter();
+            for (auto it = pool.begin(); it != pool.end();)
+            {
+                if (now - it->last_used_ms > (uint32)idle_ms.load())
+                {
+                    evicted.push_back(*it);
+                    it = pool.erase(it);
+                }
+                else
+                    ++it;
+            }
+        }
+        for (auto &&c : evicted)
+            close(c);
+    }
+
+    void clear()
+    {
+        std::vector<NdiRecvConnection> evicted{};
+        {
+            std::scoped_lock lock{pool_mutex};
+            evicted.swap(pool);
+        }
+        for (auto &&c : evicted)
+            close(c);
+    }
+
+    int getNumPooled()
+    {
+        std::scoped_lock lock{pool_mutex};
+        return (int)pool.size();
+    }
+
+    int getHits() const
+    {
+        return hits;
+    }
+
+    int getMisses() const
+    {
+        return misses;
+    }
+
+  private:
+    NdiRecvConnection open(const NDIlib_recv_create_v3_t &create,
+                           const NdiRecvProfile &profile)
+    {
+        NdiRecvConnection c{};
+        if (!p_NDILib)
+            return c;
+
+        auto recv_create = create;
+        profile.applyTo(recv_create);
+
+        c.name = create.source_to_connect_to.p_ndi_name;
+        c.profile = profile;
+        c.recv = p_NDILib->recv_create_v3(&recv_create);
+        c.framesync = p_NDILib->framesync_create(c.recv);
+
+        if (c.recv && p_metadata)
+            p_NDILib->recv_add_connection_metadata(c.recv, p_metadata);
+
+        return c;
+    }
+
+    void close(NdiRecvConnection &c)
+    {
+        if (!p_NDILib)
+            return;
+
+        // frame-sync before its receiver
+        if (c.framesync)
+            p_NDILib->framesync_destroy(c.framesync);
+        if (c.recv)
+            p_NDILib->recv_destroy(c.recv);
+
+        c.framesync = nullptr;
+        c.recv = nullptr;
+    }
+
+    // caller holds pool_mutex
+    void trim(std::vector<NdiRecvConnection> &evicted)
+    {
+        while ((int)pool.size() > max_size)
+        {
+            evicted.push_back(pool.back());
+            pool.pop_back();
+        }
+    }
+
+    const NDIlib_v5 *p_NDILib = nullptr;
+    const NDIlib_metadata_frame_t *p_metadata = nullptr;
+
+    std::mutex pool_mutex;
+    std::vector<NdiRecvConnection> pool{};
+
+    std::atomic<int> max_size{0};
+    std::atomic<int> idle_ms{0};
+    std::atomic<int> hits{0};
+    std::atomic<int> misses{0};
+};
@@ -0,0 +1,110 @@
+#pragma once
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// one background thread shared by all instances in the process, use through
+// SharedResourcePointer<NdiRestoreQueue>
+// loads the NDI runtime of new instances and sets up their endpoints after
+// session load, so creating and loading many instances does not wait for it
+// the thread starts with the first job
+class NdiRestoreQueue : private Thread
+{
+  public:
+    NdiRestoreQueue() : Thread("NDI restore") {}
+
+    ~NdiRestoreQueue() override
+    {
+        {
+            std::scoped_lock lock{queue_mutex};
+            exiting = true;
+        }
+        queue_changed.notify_all();
+        stopThread(5000);
+    }
+
+    // one pending job per owner, a newer one replaces it
+    void post(const void *owner, std::function<void()> job)
+    {
+        startThread(Thread::Priority::low);
+        {
+            std::scoped_lock lock{queue_mutex};
+            for (auto &&j : jobs)
+            {
+                if (j.owner == owner)
+                {
+                    j.run = std::move(job);
+                    return;
+                }
+            }
+            jobs.push_back({owner, std::move(job)});
+        }
+        queue_changed.notify_all();
+    }
+
+    // drops pending job of owner and waits for one that is running
+    void cancel(const void *owner)
+    {
+        std::unique_lock lock{queue_mutex};
+        jobs.erase(std::remove_if(jobs.begin(), jobs.end(),
+                                  [owner](const Job &j)
+                                  { return j.owner == owner; }),
+                   jobs.end());
+        queue_changed.wait(lock, [this, owner] { return running != owner; });
+    }
+
+    bool isPending(const void *owner)
+    {
+        std::scoped_lock lock{queue_mutex};
+        if (running == owner)
+            return true;
+        for (auto &&j : jobs)
+            if (j.owner == owner)
+                return true;
+        return false;
+    }
+
+  private:
+    struct Job
+    {
+        const void *owner;
+        std::function<void()> run;
+    };
+
+    void run() override
+    {
+        for (;;)
+        {
+            Job job{};
+            {
+                std::unique_lock lock{queue_mutex};
+                queue_changed.wait(lock,
+                                   [this] { return exiting || !jobs.empty(); });
+                if (exiting)
+                    return;
+
+                job = std::move(jobs.front());
+                jobs.pop_front();
+                running = job.owner;
+            }
+
+            job.run();
+
+            {
+                std::scoped_lock lock{queue_mutex};
+                running = nullptr;
+            }
+            queue_changed.notify_all();
+        }
+    }
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_changed;
+    std::deque<Job> jobs{};
+    const void *running = nullptr;
+    bool exiting = false;
+};
@@ -0,0 +1,23 @@
+#pragma once
+#include <JuceHeader.h>
+
+// one background thread shared by all instances in the process, use through
+// SharedResourcePointer<NdiWorkerThread>
+// clients must be removed before NDI handles they poll are destroyed
+// the thread starts with the first client
+class NdiWorkerThread : public TimeSliceThread
+{
+  public:
+    NdiWorkerThread() : TimeSliceThread("NDI worker") {}
+
+    void add(TimeSliceClient *c)
+    {
+        addTimeSliceClient(c);
+        startThread(Thread::Priority::low);
+    }
+
+    ~NdiWorkerThread() override
+    {
+        stopThread(2000);
+    }
+};
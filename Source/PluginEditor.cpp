@@ -87,6 +87,14 @@ NdiAudioProcessorEditor::NdiAudioProcessorEditor (NdiAudioProcessor& p)
     comboboxAttachment.reset(
         new ComboBoxAttachment(ap.getAPVTS(), "ndi_recv", *combobox_sources));
 
+    addAndMakeVisible(status_label);
+    status_label.setFont(lf.getPopupMenuFont());
+    status_label.setColour(Label::textColourId, Colours::grey);
+    status_label.setJustificationType(Justification::centredLeft);
+
+    addAndMakeVisible(send_meters);
+    addAndMakeVisible(recv_meters);
+
     //[/UserPreSize]
 
     setSize (640, 480);
@@ -190,6 +198,9 @@ void NdiAudioProcessorEditor::resized()
     juce__sendButton->setBounds (proportionOfWidth (0.6750f), proportionOfHeight (0.4354f), proportionOfWidth (0.2141f), proportionOfHeight (0.0917f));
     juce__recvButton->setBounds (proportionOfWidth (0.6750f), proportionOfHeight (0.7063f), proportionOfWidth (0.2141f), proportionOfHeight (0.0917f));
     //[UserResized] Add your own custom resize handling here..
+    status_label.setBounds(proportionOfWidth(0.1375f), proportionOfHeight(0.8500f), proportionOfWidth(0.7516f), proportionOfHeight(0.0917f));
+    send_meters.setBounds(proportionOfWidth(0.1375f), proportionOfHeight(0.5354f), proportionOfWidth(0.4500f), proportionOfHeight(0.0375f));
+    recv_meters.setBounds(proportionOfWidth(0.1375f), proportionOfHeight(0.8021f), proportionOfWidth(0.4500f), proportionOfHeight(0.0375f));
     //[/UserResized]
 }
 
@@ -273,15 +284,27 @@ void NdiAudioProcessorEditor::textEditorReturnKeyPressed(TextEditor& editor)
 
 void NdiAudioProcessorEditor::timerCallback()
 {
+    Trace::Scope trace{"gui", "timerCallback"};
     if (!ap.getNDILib())
+    {
+        status_label.setText(ap.getRuntimeState() ==
+                                     NdiAudioProcessor::RuntimeState::loading
+                                 ? "loading NDI runtime..."
+                                 : "NDI runtime not available",
+                             dontSendNotification);
         return;
+    }
 
     // actual NDI send name
     auto this_tx_name = ap.getNDISendName2();
 
     uint32_t no_sources;
-    const NDIlib_source_t* p_sources =
-        ap.getNDILib()->find_get_current_sources(ap.getNDIFind(), &no_sources);
+    const NDIlib_source_t* p_sources = nullptr;
+    {
+        Trace::Scope trace_find {"ndi", "find_get_current_sources"};
+        p_sources = ap.getNDILib()->find_get_current_sources(ap.getNDIFind(),
+                                                             &no_sources);
+    }
 
     combobox_sources->clear();
     for (uint32_t i = 0; i < no_sources; i++)
@@ -308,6 +331,55 @@ void NdiAudioProcessorEditor::timerCallback()
     combobox_sources->setTextWhenNothingSelected(
         ap.getNDIRecvName().isNotEmpty() ? ap.getNDIRecvTextInput()
                                          : "no source");
+
+    // may have been changed through control endpoint
+    if (!juce__textEditor->hasKeyboardFocus(true) &&
+        juce__textEditor->getText() != ap.getNDISendTextInput())
+        juce__textEditor->setText(ap.getNDISendTextInput());
+
+    String status {};
+    if (ap.getControlId() > 0)
+        status << "id " << ap.getControlId();
+    if (ap.getControlPort() > 0)
+        status << (status.isEmpty() ? "" : " ") << "on port "
+               << ap.getControlPort();
+    if (ap.isRestorePending())
+        status << (status.isEmpty() ? "" : ", ") << "connecting";
+    if (ap.hasNDISend())
+    {
+        auto n = ap.getSendConnections();
+        status << (status.isEmpty() ? "" : ", ") << "send: "
+               << (n < 0 ? String("-") : String(n)) << " receivers, idle "
+               << String(ap.getSendIdleRatio() * 100.0, 0) << "%";
+    }
+
+    // coded size against float, CPU per channel and second of audio
+    auto lossless = [&status](const char *side, LosslessStats::Totals t)
+    {
+        if (t.ratio > 0.0)
+            status << (status.isEmpty() ? "" : ", ") << side << " "
+                   << String(t.ratio * 100.0, 0) << "%, "
+                   << String(t.cpu_us, 0) << " us/ch";
+    };
+    lossless("lossless", ap.getSendLosslessStats());
+    lossless("lossless in", ap.getRecvLosslessStats());
+
+    auto buffer_target = ap.getRecvBufferTarget();
+    if (buffer_target >= 0)
+        status << (status.isEmpty() ? "" : ", ") << "buffer "
+               << buffer_target << " ms, " << ap.getRecvUnderruns()
+               << " underruns";
+
+    auto concealed = ap.getRecvConcealed();
+    if (concealed > 0)
+        status << (status.isEmpty() ? "" : ", ") << concealed
+               << " dropouts concealed";
+
+    auto sync_delay = ap.getRecvSyncDelay();
+    if (sync_delay >= 0)
+        status << (status.isEmpty() ? "" : ", ") << "sync delay "
+               << sync_delay << " samples";
+    status_label.setText(status, dontSendNotification);
 }
 //[/MiscUserCode]
 
@@ -21,6 +21,7 @@
 
 //[Headers]     -- You can add your own extra header files here --
 #include "CustomLookAndFeel.h"
+#include "MeterBridge.h"
 #include "PluginProcessor.h"
 #include <JuceHeader.h>
 
@@ -82,6 +83,11 @@ class NdiAudioProcessorEditor : public juce::AudioProcessorEditor,
     bool timer_update {false};
     String prev_text {};
 
+    Label status_label {};
+
+    MeterBridge send_meters {ap.getSendMeter()};
+    MeterBridge recv_meters {ap.getRecvMeter()};
+
     //[/UserVariables]
 
     //==============================================================================
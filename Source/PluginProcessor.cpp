@@ -1,7 +1,7 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
-std::mutex NdiAudioProcessor::init_mutex{};
+AudioThreadGuard::Mutex NdiAudioProcessor::init_mutex{};
 
 //==============================================================================
 NdiAudioProcessor::NdiAudioProcessor()
@@ -11,9 +11,78 @@ NdiAudioProcessor::NdiAudioProcessor()
               .withInput("Input", juce::AudioChannelSet::stereo(), true)
               .withOutput("Output", juce::AudioChannelSet::stereo(), true)),
       apvts{*this, nullptr, juce::Identifier("APVTS"), createParameterLayout()}
+{
+    if (juce::JUCEApplicationBase::isStandaloneApp())
+    {
+        auto pluginHolder = juce::StandalonePluginHolder::getInstance();
+
+        is_standalone = true;
+        if (pluginHolder)
+        {
+            pluginHolder->muteInput = false;
+        }
+    }
+
+    recv_pool.setLimits(RECV_POOL_SIZE, RECV_POOL_IDLE_S * 1000);
+
+    apvts.addParameterListener("recv", this);
+    apvts.addParameterListener("send", this);
+    apvts.addParameterListener("ndi_recv", this);
+
+    metadata_string = "<ndi_product long_name=\"" JucePlugin_Name
+                      "\" "
+                      " short_name=\"" JucePlugin_Name
+                      "\" "
+                      " manufacturer=\"" JucePlugin_Manufacturer
+                      "\" "
+                      " version=\" " JucePlugin_VersionString "  \" />";
+
+    ndi_metadata.p_data = metadata_string.data();
+
+    // pool idle expiry
+    startTimer(1000);
+
+    return;
+}
+
+// first prepareToPlay, hosts that only instantiate and query the plugin (e.g.
+// scanners and validators) never start threads, shared memory or NDI
+void NdiAudioProcessor::start()
+{
+    if (started.exchange(true))
+        return;
+
+    // sender connection polling
+    worker->add(this);
+
+    // reachable for bulk reconfiguration from now on
+    control_id = control->add(this);
+
+    // shared memory counters, see MetricsLayout.h
+    metrics.open(control_id);
+
+    // audio passes (plugin) or is silent (standalone) until loaded, then
+    // connections for what parameters and state recorded meanwhile
+    postConnect();
+}
+
+// restore queue, dlopen and NDI initialize, false if NDI can not run
+bool NdiAudioProcessor::loadRuntime()
 {
     std::scoped_lock init_lock(init_mutex);
 
+#if NDI_AUDIO_IO_STRESS
+    // in-process loopback instead of the runtime, see StressHarness.h
+    if (StressHarness::getSeconds() > 0)
+    {
+        hNDILib = nullptr;
+        p_NDILib = StressHarness::getStandIn();
+        ndi_find = p_NDILib->find_create_v2(&ndi_find_create);
+        recv_pool.setup(p_NDILib, &ndi_metadata);
+        return true;
+    }
+#endif
+
     std::string ndi_runtime_path{};
     auto ndi_runtime_path_included =
 #ifdef __linux__
@@ -56,7 +125,7 @@ linux_load:
         printf(
             "Please re-install the NewTek NDI Runtimes from " NDILIB_REDIST_URL
             " to use this application.");
-        return;
+        return false;
     }
 
     hNDILib = dlopen(ndi_runtime_path.c_str(), RTLD_LOCAL | RTLD_LAZY);
@@ -76,7 +145,7 @@ linux_load:
         printf(
             "Please re-install the NewTek NDI Runtimes from " NDILIB_REDIST_URL
             " to use this application.");
-        return;
+        return false;
     }
 
 #if TARGET_OS_MAC
@@ -109,7 +178,7 @@ linux_load:
                     "application.",
                     "Runtime Warning.", MB_OK);
         ShellExecuteA(NULL, "open", NDILIB_REDIST_URL, 0, 0, SW_SHOWNORMAL);
-        return;
+        return false;
     }
     hNDILib = LoadLibraryA(ndi_runtime_path.c_str());
 
@@ -129,7 +198,7 @@ linux_load:
                     "application.",
                     "Runtime Warning.", MB_OK);
         ShellExecuteA(NULL, "open", NDILIB_REDIST_URL, 0, 0, SW_SHOWNORMAL);
-        return;
+        return false;
     }
 
 #elif __APPLE__
@@ -168,64 +237,84 @@ macos_post:
         // SDK documentation). you can check this directly with a call to
         // NDIlib_is_supported_CPU()
         printf("Cannot run NDI.");
-        return;
+        return false;
     }
     ndi_find_create.show_local_sources = true;
     ndi_find = p_NDILib->find_create_v2(&ndi_find_create);
 
-    apvts.addParameterListener("recv", this);
-    apvts.addParameterListener("send", this);
-    apvts.addParameterListener("ndi_recv", this);
+    recv_pool.setup(p_NDILib, &ndi_metadata);
 
-    if (juce::JUCEApplicationBase::isStandaloneApp())
-    {
-        auto pluginHolder = juce::StandalonePluginHolder::getInstance();
+    return true;
+}
 
-        is_standalone = true;
-        if (pluginHolder)
-        {
-            pluginHolder->muteInput = false;
-        }
-    }
+// restore queue, first job of the instance loads runtime
+void NdiAudioProcessor::ensureRuntime()
+{
+    if (runtime_state.load() != RuntimeState::loading)
+        return;
 
-    metadata_string = "<ndi_product long_name=\"" JucePlugin_Name
-                      "\" "
-                      " short_name=\"" JucePlugin_Name
-                      "\" "
-                      " manufacturer=\"" JucePlugin_Manufacturer
-                      "\" "
-                      " version=\" " JucePlugin_VersionString "  \" />";
+    runtime_state.store(loadRuntime() ? RuntimeState::ready
+                                      : RuntimeState::unavailable,
+                        std::memory_order_release);
+}
 
-    ndi_metadata.p_data = metadata_string.data();
+// connections for current parameters once runtime is loaded, replaces a
+// pending job of this instance. Nothing before start(), parameters and
+// state are only recorded until then.
+void NdiAudioProcessor::postConnect()
+{
+    if (!started.load())
+        return;
 
-    return;
+    restore_queue->post(this,
+                        [this]
+                        {
+                            ensureRuntime();
+                            parameterChanged(
+                                "recv",
+                                apvts.getRawParameterValue("recv")->load());
+                            parameterChanged(
+                                "send",
+                                apvts.getRawParameterValue("send")->load());
+                        });
 }
 
 NdiAudioProcessor::~NdiAudioProcessor()
 {
-    if (!p_NDILib)
+    restore_queue->cancel(this);
+    restore_queue->cancel(&ndi_send);
+    control->remove(this);
+    stopTimer();
+    worker->removeTimeSliceClient(this);
+    metrics.close();
+    send_lossless.prepare(0, 0);
+    sync_groups->leave(recv_sync_slot);
+
+    if (!isNdiReady())
         return;
 
     if (ndi_find)
         p_NDILib->find_destroy(ndi_find);
 
-    if (ndi_framesync)
-        p_NDILib->framesync_destroy(ndi_framesync);
+    // pool disabled, released connections are closed, not parked
+    recv_pool.setLimits(0, 0);
+    releaseRecv();
+    recv_pool.clear();
 
-    if (ndi_recv)
-        p_NDILib->recv_destroy(ndi_recv);
-
-    if (ndi_send)
-        p_NDILib->send_destroy(ndi_send);
+    destroySend();
 
     p_NDILib->destroy();
 
 #ifdef dynamic_load
+    // not loaded with the stress stand-in
+    if (hNDILib)
+    {
 #if _WIN32
-    FreeLibrary(hNDILib);
+        FreeLibrary(hNDILib);
 #else
-    dlclose(hNDILib);
+        dlclose(hNDILib);
 #endif
+    }
 #endif
 }
 
@@ -289,68 +378,855 @@ void NdiAudioProcessor::changeProgramName(int index,
 //==============================================================================
 void NdiAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
 {
-    recv_buf.resize(
-        static_cast<std::vector<float, std::allocator<float>>::size_type>(
-            samplesPerBlock) *
-        (size_t)getTotalNumOutputChannels());
-
-    send_buf.resize(
-        static_cast<std::vector<float, std::allocator<float>>::size_type>(
-            samplesPerBlock) *
-        (size_t)getTotalNumInputChannels());
+    Trace::Scope trace{"param", "prepareToPlay"};
+    start();
 
-    recv_audio_frame.p_data = recv_buf.data();
-    send_audio_frame.p_data = send_buf.data();
+    {
+        // text inputs rebuild buffers on other threads, also under text_mutex
+        std::scoped_lock lock{text_mutex};
+        block_size = samplesPerBlock;
+        this->sample_rate = sampleRate;
+        auto next = makeBuffers(
+            jmax(getTotalNumInputChannels(), send_matrix->getNumOutputs()),
+            engine_quantum.load(), recv_sync_slot >= 0 || recv_timeline);
+
+        audio_lock.enter();
+        useBuffers(next);
+        audio_lock.exit();
+    }
 
-    this->sample_rate = sampleRate;
+    const auto meter_window = (int)(sampleRate * METER_WINDOW_MS / 1000);
+    send_meter.prepare(meter_window);
+    recv_meter.prepare(meter_window);
+    send_gains.prepare(sampleRate);
+    recv_gains.prepare(sampleRate);
+    block_metrics.prepare(sampleRate, samplesPerBlock);
+    prepareSendLossless();
 
-    if (!p_NDILib)
+    if (!isNdiReady())
         return;
 
     releaseResources();
     parseSendTextInput(getNDISendTextInput());
-    ndi_send_create.p_ndi_name = ndi_send_name.getCharPointer();
+
+    // restore queue may be creating connections at the same time
+    std::scoped_lock lock{parameter_lock};
 
     if (send_ok)
-        ndi_send = p_NDILib->send_create(&ndi_send_create);
+        createSend();
 
-    ndi_recv_create.bandwidth = NDIlib_recv_bandwidth_max;
-    ndi_recv_create.source_to_connect_to.p_ndi_name =
-        ndi_recv_name.getCharPointer();
+    if (recv_ok)
+        createRecv();
+}
 
-    ndi_recv_create.p_ndi_recv_name = ndi_send_name.getCharPointer();
+// everything audio thread touches lives in arena, no allocation after this
+// send side is sized for the wider of inputs and send matrix channels
+// allocates, never called under audio_lock. Caller holds text_mutex.
+NdiAudioProcessor::Buffers NdiAudioProcessor::makeBuffers(int send_channels,
+                                                          int quantum,
+                                                          bool delayed) const
+{
+    const auto engine_block = jmax(block_size, quantum);
+    const auto quantum_channels =
+        jmax(getTotalNumInputChannels(), getTotalNumOutputChannels());
+
+    const auto recv_size =
+        (size_t)engine_block * (size_t)getTotalNumOutputChannels();
+    const auto send_size = (size_t)engine_block * (size_t)send_channels;
+    const auto sync_size = delayed ? (size_t)SYNC_DELAY_LENGTH *
+                                         (size_t)getTotalNumOutputChannels()
+                                   : 0;
+    // big enough for double, float view uses the same storage
+    const auto quantum_size = (size_t)quantum * (size_t)quantum_channels;
+    const auto conceal_size =
+        (size_t)LossConcealer::historyLength(sample_rate) *
+        (size_t)(getTotalNumOutputChannels() + 1);
+
+    Buffers b{};
+    b.arena.reserve(AudioArena::bytesFor<float>(recv_size) +
+                    AudioArena::bytesFor<float>(send_size) +
+                    AudioArena::bytesFor<int>((size_t)send_channels) +
+                    AudioArena::bytesFor<float>(sync_size) +
+                    AudioArena::bytesFor<double>(quantum_size) +
+                    AudioArena::bytesFor<float>(conceal_size));
+
+    auto quantum_buf =
+        quantum_size > 0 ? b.arena.allocate<double>(quantum_size) : nullptr;
+    if (quantum_buf != nullptr)
+    {
+        std::vector<double *> d((size_t)quantum_channels);
+        std::vector<float *> f((size_t)quantum_channels);
+        for (auto c = 0; c < quantum_channels; c++)
+        {
+            d[(size_t)c] = quantum_buf + (size_t)c * (size_t)quantum;
+            f[(size_t)c] = reinterpret_cast<float *>(d[(size_t)c]);
+        }
+        b.quantum_double.setDataToReferTo(d.data(), quantum_channels,
+                                          quantum);
+        b.quantum_float.setDataToReferTo(f.data(), quantum_channels, quantum);
+    }
 
-    if (recv_ok)
-        ndi_recv = p_NDILib->recv_create_v3(&ndi_recv_create);
+    b.recv = b.arena.allocate<float>(recv_size);
+    b.send = b.arena.allocate<float>(send_size);
+    b.block = engine_block;
+    b.send_channels = send_channels;
+    b.activity_hold = b.arena.allocate<int>((size_t)send_channels);
+    b.sync = sync_size > 0 ? b.arena.allocate<float>(sync_size) : nullptr;
+    b.conceal = b.arena.allocate<float>(conceal_size);
+    return b;
+}
 
-    // We need a frame-sync.
-    ndi_framesync = p_NDILib->framesync_create(ndi_recv);
+// swaps, caller holds audio_lock and text_mutex. Previous buffers are left
+// in next and freed by the caller after audio_lock.
+void NdiAudioProcessor::useBuffers(Buffers &next)
+{
+    std::swap(arena, next.arena);
+    std::swap(quantum_float, next.quantum_float);
+    std::swap(quantum_double, next.quantum_double);
+    quantum_pos = 0;
+
+    recv_buf = next.recv;
+    send_buf = next.send;
+    buffer_block_size = next.block;
+    send_buf_channels = next.send_channels;
+    send_activity_hold = next.activity_hold;
+    recv_sync_buf = next.sync;
+    recv_sync_delay.setup(recv_sync_buf, getTotalNumOutputChannels(),
+                          SYNC_DELAY_LENGTH, sample_rate);
+    recv_concealer.setup(next.conceal, getTotalNumOutputChannels(),
+                         sample_rate);
+    send_activity_mask.fill(0);
+    send_activity_refresh = 0;
+
+    recv_audio_frame.p_data = recv_buf;
+    send_audio_frame.p_data = send_buf;
+}
+
+// sender clocking is fixed at creation, recreated when render mode changes.
+// May be called on the audio thread, the worker posts the recreation.
+void NdiAudioProcessor::setNonRealtime(bool isNonRealtime) noexcept
+{
+    if (isNonRealtime != AudioProcessor::isNonRealtime())
+        send_mode_changed.store(true, std::memory_order_release);
+    AudioProcessor::setNonRealtime(isNonRealtime);
+}
+
+// worker thread. Own key, must not replace a pending connect of this
+// instance. Before start() the sender is created with the current mode.
+void NdiAudioProcessor::pollSendMode()
+{
+    if (!send_mode_changed.exchange(false, std::memory_order_acquire))
+        return;
+
+    auto send = apvts.getRawParameterValue("send");
+    restore_queue->post(&ndi_send,
+                        [this, send] { parameterChanged("send", *send); });
 }
 
 void NdiAudioProcessor::releaseResources()
 {
-    if (!p_NDILib)
+    if (!isNdiReady())
+        return;
+
+    std::scoped_lock lock{parameter_lock};
+    releaseRecv();
+    destroySend();
+    return;
+}
+
+// swaps in a new sender, worker and audio thread never see a dead handle
+// split sender creates one sender per part, only the first clocks audio
+// codec=lossless adds the unclocked companion source for coded blocks
+void NdiAudioProcessor::createSend()
+{
+    Trace::Scope trace{"ndi", "createSend"};
+    std::scoped_lock connect_lock{connect_mutex};
+
+    // text input may change meanwhile, create settings point into these
+    String send_name{};
+    String send_groups{};
+    auto parts = 1;
+    auto coded = false;
+    {
+        std::scoped_lock lock{text_mutex};
+        send_name = ndi_send_name;
+        send_groups = groups.joinIntoString(",");
+        parts = send_split_parts;
+        coded = send_lossless_on;
+    }
+
+    NDIlib_send_create_t create{};
+    create.p_groups = send_groups.toRawUTF8();
+    // offline render must not be held to realtime by the sender clock
+    create.clock_audio = !isNonRealtime();
+    const auto clocked = create.clock_audio;
+
+    std::array<NDIlib_send_instance_t, SplitStreams::max_parts - 1> split{};
+
+    auto name =
+        parts > 1 ? SplitStreams::getPartName(send_name, 1) : send_name;
+    create.p_ndi_name = name.toRawUTF8();
+
+    auto send = p_NDILib->send_create(&create);
+    p_NDILib->send_add_connection_metadata(send, &ndi_metadata);
+
+    for (auto k = 1; k < parts; k++)
+    {
+        auto part_name = SplitStreams::getPartName(send_name, k + 1);
+        create.p_ndi_name = part_name.toRawUTF8();
+        create.clock_audio = false;
+
+        auto &part = split[(size_t)k - 1];
+        part = p_NDILib->send_create(&create);
+        if (part)
+            p_NDILib->send_add_connection_metadata(part, &ndi_metadata);
+    }
+
+    NDIlib_send_instance_t send_lossless_coded = nullptr;
+    if (coded)
+    {
+        auto coded_name = LosslessSender::getSourceName(send_name);
+        create.p_ndi_name = coded_name.toRawUTF8();
+        create.clock_audio = false;
+
+        send_lossless_coded = p_NDILib->send_create(&create);
+        if (send_lossless_coded)
+            p_NDILib->send_add_connection_metadata(send_lossless_coded,
+                                                   &ndi_metadata);
+    }
+
+    std::scoped_lock lock{send_mutex};
+
+    audio_lock.enter();
+    std::swap(send, ndi_send);
+    std::swap(split, send_split);
+    std::swap(send_lossless_coded, send_coded);
+    send_coded_connections = 0;
+    num_send_split = parts - 1;
+    send_clocked = clocked;
+    send_timecode_samples = 0;
+    send_timecode_base = Time::currentTimeMillis() * 10000;
+    send_connections = -1;
+    send_idle_samples = 0;
+    send_total_samples = 0;
+    audio_lock.exit();
+
+    if (send)
+        p_NDILib->send_destroy(send);
+    for (auto &&part : split)
+        if (part)
+            p_NDILib->send_destroy(part);
+    if (send_lossless_coded)
+        p_NDILib->send_destroy(send_lossless_coded);
+}
+
+void NdiAudioProcessor::destroySend()
+{
+    Trace::Scope trace{"ndi", "destroySend"};
+    std::scoped_lock connect_lock{connect_mutex};
+    std::scoped_lock lock{send_mutex};
+
+    std::array<NDIlib_send_instance_t, SplitStreams::max_parts - 1> split{};
+
+    audio_lock.enter();
+    auto send = ndi_send;
+    ndi_send = nullptr;
+    auto coded = send_coded;
+    send_coded = nullptr;
+    std::swap(split, send_split);
+    num_send_split = 0;
+    send_connections = -1;
+    send_coded_connections = 0;
+    audio_lock.exit();
+
+    if (send)
+        p_NDILib->send_destroy(send);
+    for (auto &&part : split)
+        if (part)
+            p_NDILib->send_destroy(part);
+    if (coded)
+        p_NDILib->send_destroy(coded);
+}
+
+// worker thread, polls faster while idle so first receiver is heard quickly
+int NdiAudioProcessor::useTimeSlice()
+{
+    Trace::Scope trace{"worker", "useTimeSlice"};
+    pollSendMode();
+    return jmin(pollSendConnections(), pollRecvMetadata(), publishMetrics());
+}
+
+int NdiAudioProcessor::pollSendConnections()
+{
+    std::scoped_lock lock{send_mutex};
+
+    if (!isNdiReady() || !ndi_send)
+    {
+        send_connections = -1;
+        return 250;
+    }
+
+    // split sender is idle only while none of its parts has a receiver
+    auto n = p_NDILib->send_get_no_connections(ndi_send, 0);
+    for (auto k = 0; k < num_send_split; k++)
+        if (send_split[(size_t)k])
+            n += p_NDILib->send_get_no_connections(send_split[(size_t)k], 0);
+
+    // coded blocks are encoded only while the companion has receivers
+    const auto coded =
+        send_coded ? p_NDILib->send_get_no_connections(send_coded, 0) : 0;
+    send_coded_connections.store(coded, std::memory_order_relaxed);
+    n += coded;
+    send_connections.store(n, std::memory_order_relaxed);
+
+    return n > 0 ? 250 : 20;
+}
+
+// worker thread, counters into the shared memory segment. Reads atomics the
+// audio thread writes and takes text_mutex, which it never does.
+int NdiAudioProcessor::publishMetrics()
+{
+    if (!metrics.isOpen())
+        return METRICS_INTERVAL_MS;
+
+    const auto now = Time::getMillisecondCounter();
+    if ((int)(metrics_next_ms - now) > 0)
+        return (int)(metrics_next_ms - now);
+    metrics_next_ms = now + METRICS_INTERVAL_MS;
+
+    const auto send_name = getNDISendName();
+    const auto recv_name = getNDIRecvName();
+    const auto times = block_metrics.takeTimes();
+    const auto rate = block_metrics.getSampleRate();
+    const auto send_lossless_stats = getSendLosslessStats();
+    const auto recv_lossless_stats = getRecvLosslessStats();
+    auto on = [this](const char *id)
+    { return apvts.getRawParameterValue(id)->load() >= 0.5f ? 1 : 0; };
+
+    metrics.write(
+        [&](MetricsExport &out)
+        {
+            // members share some of the names
+            using V = MetricsLayout::Value;
+            out.setNames(send_name, recv_name);
+            out.set(V::sample_rate, rate);
+            out.set(V::block_size, block_metrics.getBlockSize());
+            out.set(V::latency_samples, getQuantum());
+            out.set(V::blocks, block_metrics.getBlocks());
+            out.set(V::dropped_blocks, block_metrics.getDropped());
+            out.set(V::block_us_p50, times.p50);
+            out.set(V::block_us_p99, times.p99);
+            out.set(V::block_us_max, times.max);
+            out.set(V::send_on, on("send"));
+            out.set(V::send_connections, getSendConnections());
+            out.set(V::send_idle_ms,
+                    rate > 0 ? send_idle_samples.load() * 1000 / rate : 0);
+            out.set(V::recv_on, on("recv"));
+            out.set(V::recv_on_backup, isRecvOnBackup() ? 1 : 0);
+            out.set(V::recv_queue_samples, block_metrics.getQueue());
+            out.set(V::recv_target_ms, getRecvBufferTarget());
+            out.set(V::recv_underruns, getRecvUnderruns());
+            out.set(V::recv_concealed, getRecvConcealed());
+            out.set(V::recv_sync_delay, getRecvSyncDelay());
+            out.set(V::recv_drift_ppb, block_metrics.getDriftPpb());
+            out.set(V::send_lossless_permille,
+                    roundToInt(send_lossless_stats.ratio * 1000.0));
+            out.set(V::send_lossless_cpu_us,
+                    roundToInt(send_lossless_stats.cpu_us));
+            out.set(V::send_lossless_dropped, send_lossless_stats.dropped);
+            out.set(V::recv_lossless_permille,
+                    roundToInt(recv_lossless_stats.ratio * 1000.0));
+            out.set(V::recv_lossless_cpu_us,
+                    roundToInt(recv_lossless_stats.cpu_us));
+            out.set(V::recv_lossless_dropped, recv_lossless_stats.dropped);
+        });
+
+    return METRICS_INTERVAL_MS;
+}
+
+// worker thread, frame-sync leaves metadata frames on the receiver
+int NdiAudioProcessor::pollRecvMetadata()
+{
+    std::scoped_lock lock{recv_mutex};
+
+    if (!isNdiReady())
+        return 250;
+
+    // lossless packets only from the primary, one per block
+    const auto max_block =
+        jmax(block_metrics.getBlockSize(), engine_quantum.load()) + 1;
+    auto poll = [this, max_block](NDIlib_recv_instance_t recv,
+                                  ChannelActivity &activity,
+                                  LosslessReceiver *lossless)
+    {
+        if (!recv)
+            return;
+
+        NDIlib_metadata_frame_t metadata{};
+        for (auto i = 0; i < 64; i++)
+        {
+            auto type =
+                p_NDILib->recv_capture_v3(recv, nullptr, nullptr, &metadata, 0);
+            if (type == NDIlib_frame_type_none ||
+                type == NDIlib_frame_type_error)
+                break;
+            if (type != NDIlib_frame_type_metadata)
+                continue;
+
+            ChannelActivity::Mask mask{};
+            int channels = 0;
+            if (ChannelActivity::parse(metadata.p_data, mask, channels))
+                activity.store(mask);
+            else if (lossless)
+                lossless->receive(metadata.p_data, max_block, audio_lock);
+
+            p_NDILib->recv_free_metadata(recv, &metadata);
+        }
+    };
+
+    poll(recv_conn.recv, recv_activity, &recv_lossless);
+    poll(recv_backup_conn.recv, recv_backup_activity, nullptr);
+
+    if (recv_lossless.isReceiving())
+        return LOSSLESS_POLL_MS;
+
+    // a channel coming back is heard soon after its bitmap
+    if (recv_activity.isValid() || recv_backup_activity.isValid())
+        return ACTIVITY_POLL_MS;
+
+    return 20;
+}
+
+// audio thread, peak per channel with hold, bitmap sent when it changes
+// peaks come from the send copy pass
+void NdiAudioProcessor::sendChannelActivity(int numChannels, int numSamples,
+                                            int sampleRate)
+{
+    if (!send_activity_hold)
+        return;
+
+    const auto hold = (int)((int64)sampleRate *
+                            send_activity_hold_ms.load(
+                                std::memory_order_relaxed) /
+                            1000);
+
+    numChannels = jmin(numChannels, ChannelActivity::max_channels);
+
+    ChannelActivity::Mask mask{};
+    for (auto i = 0; i < numChannels; i++)
+    {
+        auto &h = send_activity_hold[i];
+        h = send_peak[(size_t)i] > ACTIVITY_THRESHOLD ? hold + numSamples
+                                                      : jmax(0, h - numSamples);
+        if (h > 0)
+            mask[(size_t)(i / 64)] |= (uint64_t)1 << (i % 64);
+    }
+
+    send_activity_refresh += numSamples;
+    if (mask == send_activity_mask && send_activity_refresh < sampleRate)
+        return;
+
+    send_activity_mask = mask;
+    send_activity_refresh = 0;
+
+    if (!ChannelActivity::format(send_activity_xml.data(),
+                                 send_activity_xml.size(), mask, numChannels))
+        return;
+
+    send_activity_frame.p_data = send_activity_xml.data();
+    send_activity_frame.length = 0;
+    send_activity_frame.timecode = NDIlib_send_timecode_synthesize;
+
+    AudioThreadGuard::Suspend ndi_call;
+    Trace::Scope trace{"ndi", "send_send_metadata"};
+    p_NDILib->send_send_metadata(ndi_send, &send_activity_frame);
+    if (send_coded)
+        p_NDILib->send_send_metadata(send_coded, &send_activity_frame);
+}
+
+// encoder thread, one coded block on the companion source. Takes only
+// send_mutex, the encoder is stopped outside of audio_lock.
+void NdiAudioProcessor::sendLossless(const char *xml, int64 timecode)
+{
+    std::scoped_lock lock{send_mutex};
+    if (!send_coded)
         return;
 
-    if (ndi_framesync)
+    NDIlib_metadata_frame_t frame{};
+    frame.p_data = const_cast<char *>(xml);
+    frame.timecode = timecode;
+
+    Trace::Scope trace{"ndi", "send_send_metadata"};
+    p_NDILib->send_send_metadata(send_coded, &frame);
+}
+
+// encoder thread, a block the codec would not make smaller
+void NdiAudioProcessor::sendLosslessAudio(const NDIlib_audio_frame_v2_t &frame)
+{
+    std::scoped_lock lock{send_mutex};
+    if (!send_coded)
+        return;
+
+    Trace::Scope trace{"ndi", "send_send_audio_v2"};
+    p_NDILib->send_send_audio_v2(send_coded, &frame);
+}
+
+// connects primary and optional backup, promoting pooled connections
+// split source connects all parts instead, backup is not used then
+// handles are swapped under audio_lock, previous ones parked in pool
+// keeps the connections when sources and options are the ones they have
+void NdiAudioProcessor::createRecv()
+{
+    Trace::Scope trace{"ndi", "createRecv"};
+    std::scoped_lock connect_lock{connect_mutex};
+
+    // text input may change meanwhile, create settings point into these
+    RecvTarget target{};
+    {
+        std::scoped_lock lock{text_mutex};
+        target.source = ndi_recv_name;
+        target.backup = ndi_recv_backup_name;
+        target.recv_name = ndi_send_name;
+        target.parts = recv_split_parts;
+        target.coded = recv_coded;
+        target.profile = recv_profile;
+    }
+
+    if (recv_conn.recv != nullptr && target == recv_target)
+        return;
+
+    const auto &source = target.source;
+    const auto parts = target.parts;
+
+    NDIlib_recv_create_v3_t create{};
+    create.p_ndi_recv_name = target.recv_name.toRawUTF8();
+    target.profile.applyTo(create);
+
+    auto name = parts > 1       ? SplitStreams::getPartName(source, 1)
+                : target.coded ? LosslessSender::getSourceName(source)
+                               : source;
+    create.source_to_connect_to.p_ndi_name = name.toRawUTF8();
+
+    auto primary = recv_pool.acquire(create);
+
+    std::array<NdiRecvConnection, SplitStreams::max_parts - 1> split{};
+    for (auto k = 1; k < parts; k++)
     {
-        p_NDILib->framesync_destroy(ndi_framesync);
-        ndi_framesync = nullptr;
+        auto part_name = SplitStreams::getPartName(source, k + 1);
+        create.source_to_connect_to.p_ndi_name = part_name.toRawUTF8();
+        split[(size_t)k - 1] = recv_pool.acquire(create);
     }
 
-    // Stop the NDI receiver.
-    if (ndi_recv)
+    NdiRecvConnection backup{};
+    if (parts == 1 && target.backup.isNotEmpty() && target.backup != source)
     {
-        p_NDILib->recv_destroy(ndi_recv);
-        ndi_recv = nullptr;
+        create.source_to_connect_to.p_ndi_name = target.backup.toRawUTF8();
+        backup = recv_pool.acquire(create);
     }
+    recv_target = target;
 
-    if (ndi_send)
     {
-        p_NDILib->send_destroy(ndi_send);
-        ndi_send = nullptr;
+        std::scoped_lock lock{recv_mutex};
+
+        audio_lock.enter();
+        std::swap(primary, recv_conn);
+        std::swap(backup, recv_backup_conn);
+        std::swap(split, recv_split);
+        num_recv_split = parts - 1;
+        recv_split_lag_blocks.fill(0);
+        recv_activity.reset();
+        recv_backup_activity.reset();
+        recv_primary_ok_samples = 0;
+        recv_primary_seen = false;
+        recv_on_backup = false;
+        recv_on_backup_shared = false;
+        recv_jitter.reset();
+        recv_concealer.reset();
+        recv_lossless.reset();
+        audio_lock.exit();
+    }
+
+    recv_pool.release(primary);
+    recv_pool.release(backup);
+    for (auto &&part : split)
+        recv_pool.release(part);
+}
+
+void NdiAudioProcessor::releaseRecv()
+{
+    Trace::Scope trace{"ndi", "releaseRecv"};
+    std::scoped_lock connect_lock{connect_mutex};
+    NdiRecvConnection primary{};
+    NdiRecvConnection backup{};
+    std::array<NdiRecvConnection, SplitStreams::max_parts - 1> split{};
+
+    {
+        std::scoped_lock lock{recv_mutex};
+
+        audio_lock.enter();
+        std::swap(primary, recv_conn);
+        std::swap(backup, recv_backup_conn);
+        std::swap(split, recv_split);
+        num_recv_split = 0;
+        recv_activity.reset();
+        recv_backup_activity.reset();
+        recv_lossless.reset();
+        audio_lock.exit();
+    }
+
+    recv_pool.release(primary);
+    recv_pool.release(backup);
+    for (auto &&part : split)
+        recv_pool.release(part);
+}
+
+void NdiAudioProcessor::timerCallback()
+{
+    recv_pool.expire();
+}
+
+// failover decision, audio thread, no locks
+// switches to backup in the block primary can not fill, reverts after
+// primary has been healthy for recv_revert_ms (0 = stay on backup)
+bool NdiAudioProcessor::selectRecvBackup(bool primary_ok, bool backup_ok,
+                                         int numSamples, int sampleRate)
+{
+    if (!primary_ok)
+    {
+        recv_primary_ok_samples = 0;
+        if (backup_ok)
+            recv_on_backup = true;
+    }
+    else
+    {
+        auto hold = static_cast<int>(
+            (int64_t)sampleRate *
+            (recv_revert_ms > 0 ? recv_revert_ms : FAILOVER_REVERT_MS) / 1000);
+
+        recv_primary_ok_samples =
+            jmin(recv_primary_ok_samples + numSamples, hold);
+
+        // never locked to backup before primary has been live once
+        if (recv_on_backup && recv_primary_ok_samples >= hold &&
+            (recv_revert_ms > 0 || !recv_primary_seen))
+            recv_on_backup = false;
+
+        if (recv_primary_ok_samples >= hold)
+            recv_primary_seen = true;
+    }
+
+    recv_on_backup_shared.store(recv_on_backup, std::memory_order_relaxed);
+    return recv_on_backup;
+}
+
+// joins group as a new member, delay line is carved once audio is prepared
+// caller holds text_mutex
+void NdiAudioProcessor::setRecvSyncGroup(const String &group)
+{
+    auto slot = group.isNotEmpty() ? sync_groups->join(group) : -1;
+
+    const auto delayed = slot >= 0 || recv_timeline;
+    const auto rebuild =
+        block_size > 0 && delayed != (recv_sync_buf != nullptr);
+    auto next = rebuild ? makeBuffers(send_buf_channels, engine_quantum.load(),
+                                      delayed)
+                        : Buffers{};
+
+    audio_lock.enter();
+    auto previous = recv_sync_slot;
+    recv_sync_slot = slot;
+    recv_sync_age = 0.0;
+    recv_sync_delay_samples = 0;
+    recv_sync_settle = 0;
+    recv_sync_delay_shared = delayed ? 0 : -1;
+    if (rebuild)
+        useBuffers(next);
+    audio_lock.exit();
+
+    sync_groups->leave(previous);
+    recv_sync_group = group;
+}
+
+// sender timeline position of the captured block against ours, the output
+// is delayed when the sender is ahead and the frame-sync skips ahead when
+// it is behind. Timecodes not from a host timeline are left alone. Audio
+// thread.
+template <typename T>
+void NdiAudioProcessor::alignRecvTimeline(
+    T *const *outputs, NDIlib_framesync_instance_t framesync,
+    const NDIlib_audio_frame_v2_t &frame, int numChannels, int numSamples,
+    int sampleRate)
+{
+    Trace::Scope trace{"audio", "timeline align"};
+    constexpr auto settle_blocks = 4;
+
+    auto skipped = false;
+
+    // double, epoch based timecodes overflow int64 in samples
+    const auto offset =
+        (double)frame.timecode * sampleRate / 1.0e7 - (double)block_timeline;
+
+    if (block_timeline >= 0 &&
+        std::abs(offset) <= recv_sync_delay.getMaxDelay(numSamples))
+    {
+        const auto target = roundToInt(offset);
+        if (target == recv_sync_delay_samples)
+        {
+            recv_sync_settle = 0;
+        }
+        else if (++recv_sync_settle >= settle_blocks)
+        {
+            recv_sync_settle = 0;
+            recv_sync_delay_samples = jmax(0, target);
+
+            // late, the next blocks start where this one should have
+            if (target < 0 && framesync && frame.no_channels > 0)
+            {
+                AudioThreadGuard::Suspend ndi_call;
+                NDIlib_audio_frame_v2_t discard{};
+                p_NDILib->framesync_capture_audio(framesync, &discard,
+                                                  sampleRate,
+                                                  frame.no_channels, -target);
+                p_NDILib->framesync_free_audio(framesync, &discard);
+                skipped = true;
+            }
+        }
+    }
+
+    recv_sync_delay.process(outputs, numChannels, numSamples,
+                            recv_sync_delay_samples);
+
+    // the skipped samples are a cut, fade out here and in on the next block
+    if (skipped)
+        recv_sync_delay.fadeOut(outputs, numChannels, numSamples);
+    recv_sync_delay_shared.store(recv_sync_delay_samples,
+                                 std::memory_order_relaxed);
+}
+
+// age of the captured block against its NDI timestamp, reported to group
+// output is delayed by the difference to the oldest member. Audio thread.
+template <typename T>
+void NdiAudioProcessor::syncRecvGroup(T *const *outputs,
+                                      const NDIlib_audio_frame_v2_t &frame,
+                                      int numChannels, int numSamples,
+                                      int sampleRate)
+{
+    Trace::Scope trace{"audio", "sync delay"};
+    constexpr auto settle_blocks = 8;
+
+    auto content = frame.timestamp != NDIlib_recv_timestamp_undefined
+                       ? frame.timestamp
+                       : frame.timecode;
+
+    if (content > 0)
+    {
+        // smoothed, callback jitter is not drift
+        auto age = (double)(sync_groups->now() - content);
+        recv_sync_age = recv_sync_age == 0.0
+                            ? age
+                            : recv_sync_age + 0.05 * (age - recv_sync_age);
+        sync_groups->report(recv_sync_slot, (int64)recv_sync_age);
+
+        auto target = sync_groups->getTargetAge(recv_sync_slot);
+        auto delay = jlimit(0, recv_sync_delay.getMaxDelay(numSamples),
+                            roundToInt(((double)target - recv_sync_age) *
+                                       sampleRate / 1.0e7));
+
+        // follow lasting changes only, each step crossfades to the new delay
+        if (std::abs(delay - recv_sync_delay_samples) > 1)
+        {
+            if (++recv_sync_settle >= settle_blocks)
+            {
+                recv_sync_delay_samples = delay;
+                recv_sync_settle = 0;
+            }
+        }
+        else
+        {
+            recv_sync_settle = 0;
+        }
+    }
+
+    recv_sync_delay.process(outputs, numChannels, numSamples,
+                            recv_sync_delay_samples);
+    recv_sync_delay_shared.store(recv_sync_delay_samples,
+                                 std::memory_order_relaxed);
+}
+
+// offline render, true if this block is taken from the frame-sync. Audio
+// thread, wait blocks it while the source catches up with the render.
+bool NdiAudioProcessor::pullOfflineRecv(int numSamples)
+{
+    if (recv_offline == OfflineRecv::silence || !recv_conn.framesync)
+        return false;
+
+    AudioThreadGuard::Suspend ndi_call;
+    Trace::Scope trace{"ndi", "offline receive"};
+
+    auto queued = [this, numSamples]
+    {
+        return p_NDILib->framesync_audio_queue_depth(recv_conn.framesync) >=
+               numSamples;
+    };
+
+    if (recv_offline == OfflineRecv::buffered)
+        return queued();
+
+    for (auto waited_ms = 0; !queued(); waited_ms++)
+    {
+        if (waited_ms >= OFFLINE_WAIT_MS)
+            return false;
+        Thread::sleep(1);
+    }
+    return true;
+}
+
+// split parts line up on the shared sender timecode of the frames just
+// captured. Parts behind the newest one drop the difference from their
+// frame-sync once it held for a few blocks. Audio thread, inside NDI suspend.
+void NdiAudioProcessor::alignRecvSplit(int sampleRate)
+{
+    constexpr auto settle_blocks = 4;
+
+    auto timecode = [this](int k) -> int64
+    {
+        return k == 0 ? recv_audio_frame.timecode
+                      : recv_split_frames[(size_t)k - 1].timecode;
+    };
+
+    auto newest = timecode(0);
+    for (auto k = 1; k <= num_recv_split; k++)
+        newest = jmax(newest, timecode(k));
+
+    for (auto k = 0; k <= num_recv_split; k++)
+    {
+        auto &blocks = recv_split_lag_blocks[(size_t)k];
+        auto lag = (newest - timecode(k)) * sampleRate / 10000000;
+
+        // unrelated timecodes, e.g. a part from another sender
+        if (lag <= 0 || lag > sampleRate)
+        {
+            blocks = 0;
+            continue;
+        }
+
+        if (++blocks < settle_blocks)
+            continue;
+        blocks = 0;
+
+        auto framesync = k == 0 ? recv_conn.framesync
+                                : recv_split[(size_t)k - 1].framesync;
+        auto channels = k == 0 ? recv_audio_frame.no_channels
+                               : recv_split_frames[(size_t)k - 1].no_channels;
+
+        if (!framesync || channels <= 0)
+            continue;
+
+        NDIlib_audio_frame_v2_t discard{};
+        p_NDILib->framesync_capture_audio(framesync, &discard, sampleRate,
+                                          channels, (int)lag);
+        p_NDILib->framesync_free_audio(framesync, &discard);
     }
-    return;
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -369,110 +1245,519 @@ void NdiAudioProcessor::processBlock2(juce::AudioBuffer<T> &buffer,
 {
     (void)midiMessages;
 
+    AudioThreadGuard::Scope audio_thread_guard;
     juce::ScopedNoDenormals noDenormals;
-    const auto totalNumInputChannels = getTotalNumInputChannels();
-    const auto totalNumOutputChannels = getTotalNumOutputChannels();
-
-    const auto numSamples = buffer.getNumSamples();
-    const auto sampleRate = static_cast<int>(getSampleRate());
+    Trace::Scope trace{"audio", "processBlock2"};
+    BlockMetrics::Scope metrics_scope{block_metrics};
 
-    if (!p_NDILib || !audio_lock.tryEnter())
+    if (!isNdiReady() || !audio_lock.tryEnter())
     {
+        block_metrics.drop();
         if (is_standalone == true)
-            for (auto i = 0; i < totalNumOutputChannels; i++)
+            for (auto i = 0; i < getTotalNumOutputChannels(); i++)
                 buffer.clear(i, 0, buffer.getNumSamples());
         return;
     }
 
-    if (send_ok)
+    // host timeline position of this block while the transport plays, and
+    // callback time when the host or the standalone player reports it
+    auto timeline = int64{-1};
+    auto device_time = int64{-1};
+    if (auto play_head = getPlayHead())
+    {
+        if (auto position = play_head->getPosition())
+        {
+            if (position->getIsPlaying() && position->getTimeInSamples())
+                timeline = *position->getTimeInSamples();
+            if (auto host_time_ns = position->getHostTimeNs())
+                device_time = getDeviceTime(*host_time_ns);
+        }
+    }
+
+    auto &engine = [this]() -> AudioBuffer<T> &
+    {
+        if constexpr (std::is_same_v<T, float>)
+            return quantum_float;
+        else
+            return quantum_double;
+    }();
+
+    // host block size, NDI calls as the host clocks them
+    const auto quantum = engine.getNumSamples();
+    if (quantum == 0)
+    {
+        block_timeline = timeline;
+        block_device_time = device_time;
+        const auto channels = buffer.getNumChannels();
+        processQuantum(buffer.getArrayOfReadPointers(), channels,
+                       buffer.getArrayOfWritePointers(), channels,
+                       buffer.getNumSamples());
+        audio_lock.exit();
+        return;
+    }
+
+    // fixed quantum, NDI calls and their cost the same on every quantum
+    const auto channels =
+        jmin(buffer.getNumChannels(), engine.getNumChannels());
+    for (auto done = 0; done < buffer.getNumSamples();)
+    {
+        auto n = jmin(quantum - quantum_pos, buffer.getNumSamples() - done);
+        for (auto c = 0; c < channels; c++)
+        {
+            auto p = buffer.getWritePointer(c, done);
+            std::swap_ranges(p, p + n, engine.getWritePointer(c, quantum_pos));
+        }
+        done += n;
+        quantum_pos += n;
+
+        if (quantum_pos == quantum)
+        {
+            // first sample of the quantum, an earlier block if it spans two
+            block_timeline = timeline >= 0 ? timeline + done - quantum : -1;
+            block_device_time =
+                device_time >= 0 && sample_rate > 0.0
+                    ? device_time + SplitStreams::toTimecode(
+                                        done - quantum, (int)sample_rate)
+                    : -1;
+            processQuantum(engine.getArrayOfReadPointers(), channels,
+                           engine.getArrayOfWritePointers(), channels,
+                           quantum);
+            quantum_pos = 0;
+        }
+    }
+
+    audio_lock.exit();
+}
+
+// standalone device callback straight into the engine, no player, MIDI or
+// extra buffer passes. False lets the player process the block instead.
+bool NdiAudioProcessor::processDeviceBlock(const float *const *inputs,
+                                           int numInputs,
+                                           float *const *outputs,
+                                           int numOutputs, int numSamples,
+                                           const std::uint64_t *hostTimeNs)
+{
+    if (!isNdiReady() || isSuspended() ||
+        engine_quantum.load(std::memory_order_relaxed) > 0)
+        return false;
+
+    AudioThreadGuard::Scope audio_thread_guard;
+    juce::ScopedNoDenormals noDenormals;
+    Trace::Scope trace{"audio", "processDeviceBlock"};
+
+    // blocks longer than the buffers take the regular path, their size is
+    // only read under audio_lock
+    const auto locked = audio_lock.tryEnter();
+    if (locked && numSamples > buffer_block_size)
+    {
+        audio_lock.exit();
+        return false;
+    }
+
+    BlockMetrics::Scope metrics_scope{block_metrics};
+
+    auto processed = 0;
+    if (locked)
+    {
+        block_timeline = -1;
+        block_device_time =
+            hostTimeNs != nullptr ? getDeviceTime(*hostTimeNs) : -1;
+        processQuantum(inputs, numInputs, outputs, numOutputs, numSamples);
+        processed = jmin(numOutputs, getTotalNumOutputChannels());
+        audio_lock.exit();
+    }
+    else
+    {
+        block_metrics.drop();
+    }
+
+    // device channels the processor does not use
+    for (auto i = processed; i < numOutputs; i++)
+        FloatVectorOperations::clear(outputs[i], numSamples);
+
+    return true;
+}
+
+// callback time on the sync group clock, -1 if the device uses a clock too
+// far from it to be the same one
+int64 NdiAudioProcessor::getDeviceTime(uint64 host_time_ns) const
+{
+    const auto t = sync_groups->fromHostTimeNs(host_time_ns);
+    return std::abs(t - sync_groups->now()) < 10000000 ? t : -1;
+}
+
+// one block through send and receive, caller holds audio_lock
+// inputs may alias outputs (host buffer), all inputs are read before outputs
+// are written
+template <typename T>
+void NdiAudioProcessor::processQuantum(const T *const *inputs, int numInputs,
+                                       T *const *outputs, int numOutputs,
+                                       int numSamples)
+{
+    Trace::Scope trace{"audio", "processQuantum"};
+    const auto totalNumInputChannels =
+        jmin(getTotalNumInputChannels(), numInputs);
+    const auto totalNumOutputChannels =
+        jmin(getTotalNumOutputChannels(), numOutputs);
+
+    const auto sampleRate = static_cast<int>(getSampleRate());
+
+    // nobody listening, skip conversion and send entirely
+    const auto send_idle =
+        send_connections.load(std::memory_order_relaxed) == 0;
+
+    if (send_ok && ndi_send)
+    {
+        send_total_samples.fetch_add(numSamples, std::memory_order_relaxed);
+        if (send_idle)
+        {
+            send_idle_samples.fetch_add(numSamples,
+                                        std::memory_order_relaxed);
+            send_resume = true;
+        }
+    }
+
+    // NDI channels, inputs as they are or rendered through send matrix
+    const auto &matrix = *send_matrix;
+    const auto use_matrix = matrix.getMode() != SendMatrix::Mode::identity;
+    const auto num_send_channels =
+        jmin(use_matrix ? matrix.getNumOutputs() : totalNumInputChannels,
+             send_buf_channels);
+
+    // idle sender still meters what it would send
+    if (send_ok && ndi_send && send_idle)
+    {
+        for (auto i = 0; i < num_send_channels; i++)
+        {
+            auto write_p = send_buf + (size_t)i * (size_t)numSamples;
+            const auto gain = send_gains.advance(i, numSamples);
+            send_meter.add(i, use_matrix
+                                  ? matrix.process(i, inputs,
+                                                   totalNumInputChannels,
+                                                   write_p, numSamples, gain)
+                                  : AudioKernels::measure(inputs[i],
+                                                          numSamples, gain));
+        }
+        send_meter.advance(num_send_channels, numSamples);
+    }
+
+    if (send_ok && ndi_send && !send_idle)
     {
         send_audio_frame.sample_rate = sampleRate;
-        send_audio_frame.no_channels = totalNumInputChannels;
+        send_audio_frame.no_channels = num_send_channels;
         send_audio_frame.no_samples = numSamples;
+        // planar float regardless of host sample type
         send_audio_frame.channel_stride_in_bytes =
-            numSamples * static_cast<int>(sizeof(T));
+            numSamples * static_cast<int>(sizeof(float));
 
-        for (auto i = 0; i < totalNumInputChannels; i++)
         {
-            auto write_p = send_audio_frame.p_data;
-            write_p += static_cast<unsigned long long>(
-                i * send_audio_frame.channel_stride_in_bytes /
-                static_cast<int>(sizeof(T)));
-            auto read_p = buffer.getReadPointer(i);
-            for (auto j = 0; j < numSamples; j++)
+            Trace::Scope trace_convert{"audio", "send convert"};
+            for (auto i = 0; i < num_send_channels; i++)
             {
-                *write_p++ = static_cast<float>(*read_p++);
+                auto write_p = send_audio_frame.p_data +
+                               static_cast<size_t>(i) *
+                                   static_cast<size_t>(numSamples);
+
+                // convert, route, apply gain and meter in one pass
+                const auto gain = send_gains.advance(i, numSamples);
+                auto levels =
+                    use_matrix
+                        ? matrix.process(i, inputs, totalNumInputChannels,
+                                         write_p, numSamples, gain)
+                        : AudioKernels::copyGainMeasure(inputs[i], write_p,
+                                                        numSamples, gain);
+                send_meter.add(i, levels);
+                if (i < MAX_CHANNELS)
+                    send_peak[(size_t)i] = levels.peak;
+
+                // first block after idle fades in, no click for new receiver
+                if (send_resume)
+                {
+                    for (auto j = 0; j < numSamples; j++)
+                        write_p[j] *= (float)j / (float)numSamples;
+                }
+            }
+        }
+        send_resume = false;
+        send_meter.advance(num_send_channels, numSamples);
+
+        if (send_activity_on.load(std::memory_order_relaxed))
+            sendChannelActivity(num_send_channels, numSamples, sampleRate);
+
+        // host timeline while its transport plays, sample position while
+        // unclocked, else device time of the block when the device tells it
+        const auto host_timecode = send_host_timecode && block_timeline >= 0;
+        const auto device_timecode =
+            !host_timecode && send_clocked && block_device_time >= 0;
+        const auto timecode =
+            host_timecode
+                ? SplitStreams::toTimecode(block_timeline, sampleRate)
+            : device_timecode
+                ? block_device_time
+                : send_timecode_base +
+                      SplitStreams::toTimecode(send_timecode_samples,
+                                               sampleRate);
+        send_timecode_samples += numSamples;
+        send_audio_frame.timecode =
+            send_clocked && !host_timecode && !device_timecode
+                ? NDIlib_send_timecode_synthesize
+                : timecode;
+
+        // coded on the companion source by the encoder thread, the push
+        // neither blocks nor allocates and stays under the guard
+        if (send_lossless_on &&
+            send_coded_connections.load(std::memory_order_relaxed) > 0)
+            send_lossless.push(send_audio_frame.p_data, num_send_channels,
+                               numSamples, sampleRate, timecode);
+
+        {
+            AudioThreadGuard::Suspend ndi_call;
+            Trace::Scope trace_send{"ndi", "send_send_audio_v2"};
+            if (num_send_split == 0)
+            {
+                p_NDILib->send_send_audio_v2(ndi_send, &send_audio_frame);
+            }
+            else
+            {
+                // contiguous channel blocks, same timecode on every part
+                const auto parts = num_send_split + 1;
+                auto part_frame = send_audio_frame;
+                part_frame.timecode = timecode;
+
+                for (auto k = 0; k < parts; k++)
+                {
+                    auto first =
+                        SplitStreams::getPartFirst(num_send_channels, parts, k);
+                    auto last = SplitStreams::getPartFirst(num_send_channels,
+                                                           parts, k + 1);
+                    auto send = k == 0 ? ndi_send : send_split[(size_t)k - 1];
+                    if (last <= first || !send)
+                        continue;
+
+                    part_frame.p_data = send_audio_frame.p_data +
+                                        static_cast<size_t>(first) *
+                                            static_cast<size_t>(numSamples);
+                    part_frame.no_channels = last - first;
+                    p_NDILib->send_send_audio_v2(send, &part_frame);
+                }
             }
         }
-        p_NDILib->send_send_audio_v2(ndi_send, &send_audio_frame);
     }
 
-    // clear output buffer
-    if (is_standalone)
+    // offline render, receive follows recv_offline instead of NDI clock
+    const auto recv_pull =
+        recv_ok && (!isNonRealtime() || pullOfflineRecv(numSamples));
+
+    // standalone is silent while not receiving, plugin passes audio through
+    // unless the block was skipped for offline render
+    if ((is_standalone || recv_ok) && !recv_pull)
         for (auto i = 0; i < totalNumOutputChannels; i++)
-            buffer.clear(i, 0, buffer.getNumSamples());
+            FloatVectorOperations::clear(outputs[i], numSamples);
 
-    if (recv_ok)
+    if (recv_pull)
     {
-        // clear output buffer
-        if (!is_standalone)
-            for (auto i = 0; i < totalNumOutputChannels; i++)
-                buffer.clear(i, 0, buffer.getNumSamples());
+        auto framesync = recv_conn.framesync;
+        auto framesync_backup = recv_backup_conn.framesync;
 
-        // get source channel count
-        p_NDILib->framesync_capture_audio(ndi_framesync, &recv_audio_frame, 0,
-                                          0, 0);
+        // queued audio, frame-sync pads the rest of a block with silence
+        auto framesync_depth = 0;
+        auto backup_depth = 0;
+        {
+            AudioThreadGuard::Suspend ndi_call;
+            Trace::Scope trace_depth{"ndi", "framesync_audio_queue_depth"};
+            framesync_depth = p_NDILib->framesync_audio_queue_depth(framesync);
+            if (framesync_backup)
+                backup_depth =
+                    p_NDILib->framesync_audio_queue_depth(framesync_backup);
+        }
 
-        auto num_source_channels = recv_audio_frame.no_channels;
+        // codec=lossless companion, decoded packets stand in for the
+        // frame-sync of the primary. Blocks the sender kept as audio frames
+        // arrive through the frame-sync instead.
+        const auto lossless =
+            num_recv_split == 0 && recv_lossless.isActive(sampleRate) &&
+            (recv_lossless.getReady() > 0 || framesync_depth < numSamples);
+        const auto primary_depth =
+            lossless ? recv_lossless.getReady() : framesync_depth;
+
+        // bitmaps of audio still queued keep their channels active
+        recv_activity.follow(primary_depth, numSamples);
+        recv_backup_activity.follow(backup_depth, numSamples);
+
+        // failover, primary is starved when it can not fill this block
+        auto use_backup = false;
+        if (framesync_backup)
+            use_backup =
+                selectRecvBackup(primary_depth >= numSamples,
+                                 backup_depth >= numSamples, numSamples,
+                                 sampleRate);
+
+        // adaptive depth, a sample more or less is stretched over the block
+        auto pull = numSamples;
+        if (recv_jitter.isActive() && num_recv_split == 0 && !isNonRealtime())
+            pull = recv_jitter.pull(primary_depth, numSamples, sampleRate);
+        block_metrics.recvPull(framesync, primary_depth, pull, numSamples,
+                               sampleRate);
 
-        p_NDILib->framesync_capture_audio(ndi_framesync, &recv_audio_frame,
-                                          sampleRate, num_source_channels,
-                                          numSamples);
+        {
+            AudioThreadGuard::Suspend ndi_call;
+            Trace::Scope trace_capture{"ndi", "framesync_capture_audio"};
+
+            // get source channel count
+            p_NDILib->framesync_capture_audio(framesync, &recv_audio_frame, 0,
+                                              0, 0);
+            p_NDILib->framesync_capture_audio(framesync, &recv_audio_frame,
+                                              sampleRate,
+                                              recv_audio_frame.no_channels,
+                                              pull);
+
+            // backup is always pulled to stay buffered and clock aligned
+            if (framesync_backup)
+            {
+                p_NDILib->framesync_capture_audio(
+                    framesync_backup, &recv_backup_audio_frame, 0, 0, 0);
+                p_NDILib->framesync_capture_audio(
+                    framesync_backup, &recv_backup_audio_frame, sampleRate,
+                    recv_backup_audio_frame.no_channels, pull);
+            }
+
+            // remaining parts of a split source
+            for (auto k = 0; k < num_recv_split; k++)
+            {
+                auto part_framesync = recv_split[(size_t)k].framesync;
+                auto &part_frame = recv_split_frames[(size_t)k];
+                if (!part_framesync)
+                {
+                    part_frame = {};
+                    continue;
+                }
+                p_NDILib->framesync_capture_audio(part_framesync, &part_frame,
+                                                  0, 0, 0);
+                p_NDILib->framesync_capture_audio(
+                    part_framesync, &part_frame, sampleRate,
+                    part_frame.no_channels, numSamples);
+            }
+
+            if (num_recv_split > 0)
+                alignRecvSplit(sampleRate);
+        }
+
+        const auto &frame = use_backup ? recv_backup_audio_frame
+                            : lossless ? recv_lossless.read(pull)
+                                       : recv_audio_frame;
+        const auto &activity = use_backup ? recv_backup_activity
+                                          : recv_activity;
+        // split parts continue the channel numbering of part 1
+        auto num_source_channels = frame.no_channels;
+        for (auto k = 0; k < num_recv_split; k++)
+            num_source_channels += recv_split_frames[(size_t)k].no_channels;
 
         // select channels logic
         auto select_channels_ok = false;
 
-        if (recv_channels.size() > 0 &&
-            recv_channels.size() <= totalNumOutputChannels)
+        if (num_recv_channels > 0 &&
+            num_recv_channels <= totalNumOutputChannels)
         {
             select_channels_ok = true;
-            for (auto &&i : recv_channels)
+            for (auto i = 0; i < num_recv_channels; i++)
             {
-                if (i > num_source_channels)
+                if (recv_channels[(size_t)i] >= num_source_channels)
                     select_channels_ok = false;
             }
         }
 
         auto num_channels =
             select_channels_ok
-                ? jmin((int)recv_channels.size(), totalNumOutputChannels)
+                ? jmin(num_recv_channels, totalNumOutputChannels)
                 : jmin(totalNumOutputChannels, num_source_channels);
 
-        for (auto i = 0; i < num_channels; i++)
         {
-            auto n = i;
-            if (select_channels_ok)
-                n = recv_channels[i];
-
-            // skip if -1
-            if (n < 0)
-                continue;
-
-            auto read_p = recv_audio_frame.p_data;
-            read_p += static_cast<unsigned long long>(
-                n * recv_audio_frame.channel_stride_in_bytes /
-                static_cast<int>(sizeof(T)));
-            auto write_p = buffer.getWritePointer(i);
-            for (auto j = 0; j < numSamples; j++)
+            Trace::Scope trace_convert{"audio", "recv convert"};
+            // every output written once, as copy or as silence
+            for (auto i = 0; i < totalNumOutputChannels; i++)
             {
-                *write_p++ = read_p ? *read_p++ : 0;
+                // every block, ramps keep moving on silent outputs
+                const auto gain = recv_gains.advance(i, numSamples);
+
+                auto n = i < num_channels ? i : -1;
+                if (select_channels_ok && n >= 0)
+                    n = recv_channels[(size_t)i];
+                if (n >= 0 && !activity.isActive(n))
+                    n = -1;
+
+                // part holding source channel n
+                const auto *part = &frame;
+                for (auto k = 0; n >= part->no_channels && k < num_recv_split;
+                     k++)
+                {
+                    n -= part->no_channels;
+                    part = &recv_split_frames[(size_t)k];
+                }
+
+                // -1, silent at source or part missing
+                if (n < 0 || n >= part->no_channels || part->p_data == nullptr)
+                {
+                    FloatVectorOperations::clear(outputs[i], numSamples);
+                    continue;
+                }
+
+                // NDI stride is in bytes of float, not of host sample type
+                auto read_p = part->p_data +
+                              static_cast<size_t>(n) *
+                                  static_cast<size_t>(
+                                      part->channel_stride_in_bytes /
+                                      static_cast<int>(sizeof(float)));
+
+                // a frame may hold less than pulled, e.g. split parts taken
+                // at numSamples or decoded packets, only what it holds is read
+                const auto held = jmin(pull, part->no_samples);
+
+                // convert, apply gain and meter in one pass
+                recv_meter.add(i, held == numSamples
+                                      ? AudioKernels::copyGainMeasure(
+                                            read_p, outputs[i], numSamples,
+                                            gain)
+                                      : AudioKernels::stretchMeasure(
+                                            read_p, held, outputs[i],
+                                            numSamples, gain));
             }
         }
+        recv_meter.advance(num_channels, numSamples);
+
+        // replace padding of a starved frame-sync, parts are not tracked
+        if (recv_conceal)
+        {
+            Trace::Scope trace_conceal{"audio", "recv conceal"};
+            const auto queued = use_backup ? backup_depth : primary_depth;
+            const auto valid =
+                num_recv_split > 0 || queued >= pull
+                    ? numSamples
+                    : (int)((int64)queued * numSamples / pull);
+            recv_concealer.process(outputs, totalNumOutputChannels,
+                                   numSamples, valid);
+        }
+
+        // delay output to line up with the host timeline or the group
+        if (recv_timeline)
+            alignRecvTimeline(outputs,
+                              use_backup ? framesync_backup : framesync, frame,
+                              totalNumOutputChannels, numSamples, sampleRate);
+        else if (recv_sync_slot >= 0)
+            syncRecvGroup(outputs, frame, totalNumOutputChannels, numSamples,
+                          sampleRate);
 
         // Free the original frame.
-        p_NDILib->framesync_free_audio(ndi_framesync, &recv_audio_frame);
+        AudioThreadGuard::Suspend ndi_call;
+        Trace::Scope trace_free{"ndi", "framesync_free_audio"};
+        p_NDILib->framesync_free_audio(framesync, &recv_audio_frame);
+        if (framesync_backup)
+            p_NDILib->framesync_free_audio(framesync_backup,
+                                           &recv_backup_audio_frame);
+        for (auto k = 0; k < num_recv_split; k++)
+            if (recv_split[(size_t)k].framesync)
+                p_NDILib->framesync_free_audio(recv_split[(size_t)k].framesync,
+                                               &recv_split_frames[(size_t)k]);
     }
-    audio_lock.exit();
 }
 
 //==============================================================================
@@ -488,40 +1773,60 @@ juce::AudioProcessorEditor *NdiAudioProcessor::createEditor()
 }
 
 //================================================================= =
+// header and APVTS tree in ValueTree binary form, faster to write and read
+// than XML with many instances in a session
 void NdiAudioProcessor::getStateInformation(juce::MemoryBlock &destData)
 {
-    // block. You should use this method to store your parameters in
-    // the memory block. You could do that either as raw data, or use the X
-    // ML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
-
     auto state = apvts.copyState();
     auto node = state.getOrCreateChildWithName("text_input", nullptr);
     node.setProperty("recv_text_input", recv_text_input, nullptr);
     node.setProperty("send_text_input", send_text_input, nullptr);
-    std::unique_ptr<juce::XmlElement> xml(state.createXml());
-    copyXmlToBinary(*xml, destData);
+
+    juce::MemoryOutputStream out{destData, false};
+    out.writeInt(STATE_MAGIC);
+    out.writeInt(STATE_VERSION);
+    state.writeToStream(out);
 }
 
+// reads binary state or XML state of older versions, NDI connections are set
+// up later on the restore queue so loading does not wait for them
 void NdiAudioProcessor::setStateInformation(const void *data, int sizeInBytes)
 {
-    // memory You should use this method to restore your paramete
-    // rs from this memory block, whose contents will have been created by the
-    // getStateInformation()
-    // call.
-    std::unique_ptr<juce::XmlElement> xmlState(
-        getXmlFromBinary(data, sizeInBytes));
+    juce::ValueTree state{};
+
+    juce::MemoryInputStream in{data, (size_t)jmax(0, sizeInBytes), false};
+    if (sizeInBytes >= 8 && in.readInt() == STATE_MAGIC)
+    {
+        // newer versions may only append to the tree
+        if (in.readInt() >= 1)
+            state = juce::ValueTree::readFromStream(in);
+    }
+    else
+    {
+        std::unique_ptr<juce::XmlElement> xml(
+            getXmlFromBinary(data, sizeInBytes));
+        if (xml != nullptr)
+            state = juce::ValueTree::fromXml(*xml);
+    }
 
-    if (xmlState.get() != nullptr)
-        if (xmlState->hasTagName(apvts.state.getType()))
-            apvts.replaceState(juce::ValueTree::fromXml(*xmlState));
+    // replaceState would create connections inline through the listener
+    apvts.removeParameterListener("recv", this);
+    apvts.removeParameterListener("send", this);
+    apvts.removeParameterListener("ndi_recv", this);
+
+    if (state.hasType(apvts.state.getType()))
+        apvts.replaceState(state);
+
+    apvts.addParameterListener("recv", this);
+    apvts.addParameterListener("send", this);
+    apvts.addParameterListener("ndi_recv", this);
 
     auto node = apvts.state.getOrCreateChildWithName("text_input", nullptr);
     parseRecvTextInput(node.getProperty("recv_text_input"));
     parseSendTextInput(node.getProperty("send_text_input"));
 
-    parameterChanged("recv", apvts.getRawParameterValue("recv")->load());
-    parameterChanged("send", apvts.getRawParameterValue("send")->load());
+    // a later load replaces a restore that has not run yet
+    postConnect();
 
     return;
 }
@@ -529,73 +1834,50 @@ void NdiAudioProcessor::setStateInformation(const void *data, int sizeInBytes)
 void NdiAudioProcessor::parameterChanged(const String &parameterID,
                                          float newValue)
 {
-    if (!p_NDILib)
+    // applied by restore queue once started and runtime is loaded
+    if (runtime_state.load() == RuntimeState::loading)
+        postConnect();
+
+    if (!isNdiReady())
         return;
 
-    parameter_lock.enter();
-    audio_lock.enter();
+    Trace::Scope trace{"param", "parameterChanged"};
+    std::scoped_lock lock{parameter_lock};
 
     if (parameterID == "send")
     {
+        audio_lock.enter();
         send_ok = false;
+        audio_lock.exit();
 
-        if (newValue >= 0.5f && ndi_send_name.isNotEmpty())
+        if (newValue >= 0.5f && getNDISendName().isNotEmpty())
         {
-            if (ndi_send)
-            {
-                auto p = ndi_send;
-                ndi_send = nullptr;
-                p_NDILib->send_destroy(p);
-            }
-
-            auto name = ndi_send_name.getCharPointer();
-
-            ndi_send_create.p_ndi_name = name;
-            ndi_send_create.p_groups =
-                groups.joinIntoString(",").getCharPointer();
-            ndi_send_create.clock_audio = true;
-            ndi_send = p_NDILib->send_create(&ndi_send_create);
-
-            p_NDILib->send_add_connection_metadata(ndi_send, &ndi_metadata);
+            // swaps sender under audio_lock
+            createSend();
 
+            audio_lock.enter();
             send_ok = true;
+            audio_lock.exit();
         }
     }
     if (parameterID == "recv" || parameterID == "ndi_recv")
     {
-        recv_ok = false;
-
         if (newValue >= 0.5f || parameterID == "ndi_recv")
         {
-            if (ndi_framesync)
-            {
-                p_NDILib->framesync_destroy(ndi_framesync);
-                ndi_framesync = nullptr;
-            }
-
-            if (ndi_recv)
-            {
-                auto p = ndi_recv;
-                ndi_recv = nullptr;
-                p_NDILib->recv_destroy(p);
-            }
-
-            auto name = ndi_recv_name.getCharPointer();
-            ndi_recv_create.source_to_connect_to.p_ndi_name = name;
-
-            ndi_recv_create.p_ndi_recv_name = ndi_send_name.getCharPointer();
-
-            ndi_recv = p_NDILib->recv_create_v3(&ndi_recv_create);
-            ndi_framesync = p_NDILib->framesync_create(ndi_recv);
-
-            p_NDILib->recv_add_connection_metadata(ndi_recv, &ndi_metadata);
+            // swaps connections under audio_lock
+            createRecv();
 
+            audio_lock.enter();
             recv_ok = true;
+            audio_lock.exit();
+        }
+        else
+        {
+            audio_lock.enter();
+            recv_ok = false;
+            audio_lock.exit();
         }
     }
-
-    audio_lock.exit();
-    parameter_lock.exit();
 }
 
 //==============================================================================
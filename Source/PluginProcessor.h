@@ -20,17 +20,82 @@
 #include <stdlib.h>
 #endif
 #include <Processing.NDI.Lib.h>
+
+#include "AudioArena.h"
+#include "AudioThreadGuard.h"
+#include "ChannelGains.h"
+#include "ChannelActivity.h"
+#include "ControlServer.h"
+#include "DeviceBridge.h"
+#include "JitterControl.h"
+#include "LevelMeter.h"
+#include "LossConcealer.h"
+#include "LosslessStream.h"
+#include "MetricsExport.h"
+#include "NdiRecvPool.h"
+#include "NdiRestoreQueue.h"
+#include "NdiWorkerThread.h"
+#include "SendMatrix.h"
+#include "SplitStreams.h"
+#include "StressHarness.h"
+#include "SyncGroups.h"
+#include "Trace.h"
 //==============================================================================
 /**
  */
 
 constexpr auto LINEAR_REGRESSION_POINTS = 512;
 constexpr auto LISTEN_PORT = 55960;
+constexpr auto MAX_CHANNELS = 256;
+constexpr auto FAILOVER_REVERT_MS = 500;
+constexpr auto RECV_POOL_SIZE = 2;
+constexpr auto RECV_POOL_IDLE_S = 60;
+constexpr auto SYNC_DELAY_LENGTH = 8192; // samples, power of two
+constexpr auto ACTIVITY_HOLD_MS = 500;
+constexpr auto ACTIVITY_THRESHOLD = 1.0e-5f; // -100 dBFS
+constexpr auto METER_WINDOW_MS = 50;
+constexpr auto METRICS_INTERVAL_MS = 1000; // shared memory export
+constexpr auto OFFLINE_WAIT_MS = 1000; // per block, offline=wait
+constexpr auto JITTER_MIN_MS = 0;      // jitter=auto bounds
+constexpr auto JITTER_MAX_MS = 250;
+constexpr auto LOSSLESS_POLL_MS = 2; // worker, while packets arrive
+constexpr auto ACTIVITY_POLL_MS = 5; // worker, while bitmaps arrive
+constexpr auto MIN_QUANTUM = 16;   // samples
+constexpr auto MAX_QUANTUM = 4096; // samples
+constexpr auto STATE_MAGIC = 0x5341444e; // "NDAS"
+constexpr auto STATE_VERSION = 1;
+
+static_assert(ChannelActivity::max_channels == MAX_CHANNELS);
+static_assert(ControlServer::default_port == LISTEN_PORT);
+static_assert(LevelMeter::max_channels == MAX_CHANNELS);
+static_assert(LosslessCodec::max_channels == MAX_CHANNELS);
+static_assert(SendMatrix::max_outputs == MAX_CHANNELS);
+static_assert(MAX_QUANTUM < SYNC_DELAY_LENGTH);
 
 class NdiAudioProcessor : public juce::AudioProcessor,
-                          public juce::AudioProcessorValueTreeState::Listener
+                          public juce::AudioProcessorValueTreeState::Listener,
+                          private juce::Timer,
+                          private juce::TimeSliceClient,
+                          private ControlServer::Client,
+                          public DeviceBridge
 {
 public:
+    // NDI runtime is loaded in the background after construction
+    enum class RuntimeState
+    {
+        loading,
+        ready,
+        unavailable // not installed or unsupported CPU
+    };
+
+    // what receive does while the host renders faster than realtime
+    enum class OfflineRecv
+    {
+        silence,  // frame-sync is not touched
+        buffered, // blocks the frame-sync already holds, silence otherwise
+        wait      // blocks until the frame-sync holds the block
+    };
+
     //==============================================================================
     NdiAudioProcessor();
     ~NdiAudioProcessor() override;
@@ -38,6 +103,7 @@ public:
     //==============================================================================
     void prepareToPlay(double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
+    void setNonRealtime(bool isNonRealtime) noexcept override;
 
     bool isBusesLayoutSupported(const BusesLayout &layouts) const override;
 
@@ -57,6 +123,17 @@ public:
     template <typename T>
     void processBlock2(juce::AudioBuffer<T> &, juce::MidiBuffer &);
 
+    bool processDeviceBlock(const float *const *inputs, int numInputs,
+                            float *const *outputs, int numOutputs,
+                            int numSamples,
+                            const std::uint64_t *hostTimeNs) override;
+
+    // samples per internal block, 0 if host blocks are processed as they are
+    int getQuantum() const
+    {
+        return engine_quantum.load(std::memory_order_relaxed);
+    }
+
     //==============================================================================
     juce::AudioProcessorEditor *createEditor() override;
     bool hasEditor() const override;
@@ -89,12 +166,28 @@ public:
 
     NDIlib_recv_instance_t getNDIRecv()
     {
-        return ndi_recv;
+        return recv_conn.recv;
+    }
+
+    NdiRecvPool &getRecvPool()
+    {
+        return recv_pool;
+    }
+
+    // input levels as sent, output levels as received
+    const LevelMeter &getSendMeter() const
+    {
+        return send_meter;
+    }
+
+    const LevelMeter &getRecvMeter() const
+    {
+        return recv_meter;
     }
 
     NDIlib_find_instance_t getNDIFind()
     {
-        return ndi_find;
+        return isNdiReady() ? ndi_find : nullptr;
     }
 
     String getNDIRecvName()
@@ -112,7 +205,21 @@ public:
         auto v = StringArray::fromTokens(s, ";", "\"");
 
         groups.clear();
-        recv_channels.clear();
+        Array<int> channels{};
+        ndi_recv_backup_name = {};
+        auto revert_ms = FAILOVER_REVERT_MS;
+        auto pool_size = RECV_POOL_SIZE;
+        auto pool_idle_s = RECV_POOL_IDLE_S;
+        recv_split_parts = 1;
+        recv_coded = false;
+        String sync_group{};
+        auto offline = OfflineRecv::silence;
+        auto jitter_min_ms = 0;
+        auto jitter_max_ms = 0;
+        auto conceal = true;
+        NdiRecvProfile profile{};
+        auto timeline = false;
+        String gains_text{};
         for (auto &&i : v)
         {
             // name part
@@ -147,16 +254,187 @@ public:
                         for (; (first > 0 ? first - 1 : first) < second;
                              (first > 0 ? first++ : second--))
                         {
-                            recv_channels.add(first - 1);
+                            channels.add(first - 1);
                         }
                     }
                     else if (j.getIntValue() >= 0)
                     {
-                        recv_channels.add(j.getIntValue() - 1);
+                        channels.add(j.getIntValue() - 1);
                     }
                 }
             }
+
+            // options, e.g. backup=MACHINE (SOURCE), revert=off
+            if (v.indexOf(i) == 2)
+            {
+                auto options = parseOptions(i);
+
+                ndi_recv_backup_name = options["backup"];
+
+                auto revert = options["revert"];
+                if (revert == "off" || revert == "manual")
+                    revert_ms = 0;
+                else if (revert.containsOnly("0123456789") &&
+                         revert.isNotEmpty())
+                    revert_ms = revert.getIntValue();
+
+                // warm connections kept for recently used sources
+                if (options.containsKey("pool"))
+                    pool_size = options["pool"].getIntValue();
+                if (options.containsKey("idle"))
+                    pool_idle_s = options["idle"].getIntValue();
+
+                // source sent as parallel parts
+                if (options.containsKey("split"))
+                    recv_split_parts = jlimit(1, SplitStreams::max_parts,
+                                              options["split"].getIntValue());
+
+                // coded blocks of a codec=lossless sender, not with split
+                recv_coded = options["codec"] == "lossless" &&
+                             recv_split_parts == 1;
+
+                // output aligned with other receivers in the same group
+                sync_group = options["sync"];
+
+                // offline render, e.g. offline=wait
+                if (options["offline"] == "buffered")
+                    offline = OfflineRecv::buffered;
+                else if (options["offline"] == "wait")
+                    offline = OfflineRecv::wait;
+
+                // adaptive buffer depth, jitter=auto or bounds jitter=5-200
+                auto jitter = options["jitter"];
+                if (jitter == "auto")
+                {
+                    jitter_min_ms = JITTER_MIN_MS;
+                    jitter_max_ms = JITTER_MAX_MS;
+                }
+                else if (jitter.containsChar('-'))
+                {
+                    jitter_min_ms = jitter.upToFirstOccurrenceOf("-", false,
+                                                                 false)
+                                        .getIntValue();
+                    jitter_max_ms = jitter.fromFirstOccurrenceOf("-", false,
+                                                                 false)
+                                        .getIntValue();
+                }
+
+                // dropout concealment is on unless conceal=off
+                conceal = options["conceal"] != "off";
+
+                // e.g. bandwidth=lowest,color=fastest,fields=off
+                profile = NdiRecvProfile::fromOptions(options);
+
+                // play at the host timeline position the sender stamped
+                timeline = options["timeline"] == "on";
+            }
+
+            // output gains, e.g. 0,-6,mute,-3 inv
+            if (v.indexOf(i) == 3)
+                gains_text = i.trim();
+        }
+
+        if (sync_group != recv_sync_group)
+            setRecvSyncGroup(sync_group);
+
+        recv_pool.setLimits(pool_size, pool_idle_s * 1000);
+
+        const auto gains = ChannelGains::parse(gains_text);
+
+        // delay line only while aligning to a timeline or group
+        const auto delayed = timeline || recv_sync_slot >= 0;
+        const auto rebuild = timeline != recv_timeline && block_size > 0 &&
+                             delayed != (recv_sync_buf != nullptr);
+        auto next = rebuild ? makeBuffers(send_buf_channels,
+                                          engine_quantum.load(), delayed)
+                            : Buffers{};
+
+        // publish to fixed storage read by audio thread
+        audio_lock.enter();
+        num_recv_channels = jmin(channels.size(), MAX_CHANNELS);
+        for (auto i = 0; i < num_recv_channels; i++)
+            recv_channels[(size_t)i] = channels[i];
+        recv_profile = profile;
+        recv_revert_ms = revert_ms;
+        recv_offline = offline;
+        recv_jitter.setBounds(jitter_min_ms, jitter_max_ms);
+        recv_conceal = conceal;
+        recv_gains.setTargets(gains);
+        if (timeline != recv_timeline)
+        {
+            recv_timeline = timeline;
+            recv_sync_delay_samples = 0;
+            recv_sync_settle = 0;
+            recv_sync_delay_shared = delayed ? 0 : -1;
+            if (rebuild)
+                useBuffers(next);
         }
+        audio_lock.exit();
+    }
+
+    String getNDIRecvBackupName()
+    {
+        std::scoped_lock lock{text_mutex};
+        return ndi_recv_backup_name;
+    }
+
+    // id on the local control endpoint, 0 if not registered
+    int getControlId() const
+    {
+        return control_id;
+    }
+
+    // TCP port of the control endpoint, -1 while not listening
+    int getControlPort() const
+    {
+        return control->getPort();
+    }
+
+    // true until NDI connections of a loaded session are set up
+    bool isRestorePending()
+    {
+        return restore_queue->isPending(this);
+    }
+
+    // samples output is delayed by to match sync group, -1 if not in one
+    int getRecvSyncDelay() const
+    {
+        return recv_sync_delay_shared.load(std::memory_order_relaxed);
+    }
+
+    // adaptive receive buffer target in ms, -1 if not enabled
+    int getRecvBufferTarget() const
+    {
+        return recv_jitter.getTargetMs();
+    }
+
+    int getRecvUnderruns() const
+    {
+        return recv_jitter.getUnderruns();
+    }
+
+    // receive dropouts concealed since connecting
+    int getRecvConcealed() const
+    {
+        return recv_concealer.getEvents();
+    }
+
+    // codec=lossless, coded size against float and CPU per channel
+    LosslessStats::Totals getSendLosslessStats() const
+    {
+        return send_lossless.getStats();
+    }
+
+    // decoded from a source sending codec=lossless, since connecting
+    LosslessStats::Totals getRecvLosslessStats() const
+    {
+        return recv_lossless.getStats();
+    }
+
+    // true while audio is taken from backup source
+    bool isRecvOnBackup() const
+    {
+        return recv_on_backup_shared.load(std::memory_order_relaxed);
     }
 
     String getNDISendName()
@@ -178,45 +456,134 @@ public:
     }
 
     // actual NDI send name
+    // name the runtime gives the sender, ndi_send is swapped under send_mutex
     String getNDISendName2()
     {
-        std::scoped_lock lock{text_mutex};
+        std::scoped_lock lock{send_mutex};
         return ndi_send ? p_NDILib->send_get_source_name(ndi_send)->p_ndi_name
                         : "";
     }
 
     void parseSendTextInput(String s)
     {
-        text_mutex.lock();
-
-        s = s.trim();
-        send_text_input = s;
-        auto v = StringArray::fromTokens(s, ";", "\"");
-
-        groups.clear();
-        for (auto &&i : v)
+        auto quantum = 0;
+        auto quantum_changed = false;
         {
-            // name part
-            if (v.indexOf(i) == 0)
+            std::scoped_lock lock{text_mutex};
+
+            s = s.trim();
+            send_text_input = s;
+            auto v = StringArray::fromTokens(s, ";", "\"");
+
+            groups.clear();
+            auto activity = false;
+            auto activity_hold_ms = ACTIVITY_HOLD_MS;
+            String matrix_text{};
+            auto host_timecode = false;
+            auto lossless = false;
+            String gains_text{};
+            send_split_parts = 1;
+            for (auto &&i : v)
             {
-                i = i.trim();
-                ndi_send_name = i;
-            }
+                // name part
+                if (v.indexOf(i) == 0)
+                {
+                    i = i.trim();
+                    ndi_send_name = i;
+                }
 
-            // groups
-            if (v.indexOf(i) == 1)
-            {
-                i = i.trim();
-                auto t = StringArray::fromTokens(i, ",", "");
-                t.trim();
-                t.removeDuplicates(false);
-                t.removeEmptyStrings();
+                // groups
+                if (v.indexOf(i) == 1)
+                {
+                    i = i.trim();
+                    auto t = StringArray::fromTokens(i, ",", "");
+                    t.trim();
+                    t.removeDuplicates(false);
+                    t.removeEmptyStrings();
+
+                    groups = t;
+                }
+
+                // options, e.g. activity=on, hold=1000
+                if (v.indexOf(i) == 2)
+                {
+                    auto options = parseOptions(i);
+
+                    auto a = options["activity"];
+                    activity = a == "on" || a == "1" || a == "true";
+                    if (options.containsKey("hold"))
+                        activity_hold_ms =
+                            jmax(0, options["hold"].getIntValue());
+
+                    // channels spread over parallel senders
+                    if (options.containsKey("split"))
+                        send_split_parts =
+                            jlimit(1, SplitStreams::max_parts,
+                                   options["split"].getIntValue());
+
+                    // fixed internal block, host blocks pass through a FIFO
+                    if (options.containsKey("quantum"))
+                    {
+                        quantum = options["quantum"].getIntValue();
+                        if (quantum > 0)
+                            quantum = jlimit(MIN_QUANTUM, MAX_QUANTUM, quantum);
+                    }
+
+                    // frames stamped with host timeline position
+                    host_timecode = options["timecode"] == "host";
+
+                    // coded blocks in metadata frames, one stream, no split
+                    lossless = options["codec"] == "lossless";
+                    if (lossless)
+                        send_split_parts = 1;
+                }
+
+                // matrix, e.g. 1+2@-6,2+1@-6,3-8
+                if (v.indexOf(i) == 3)
+                    matrix_text = i.trim();
 
-                groups = t;
+                // NDI channel gains, e.g. 0,-6,mute,-3 inv
+                if (v.indexOf(i) == 4)
+                    gains_text = i.trim();
             }
+
+            send_activity_on = activity;
+            send_activity_hold_ms = activity_hold_ms;
+
+            // compile into the copy audio thread is not using, then swap
+            auto &matrix = send_matrix == &send_matrices[0] ? send_matrices[1]
+                                                           : send_matrices[0];
+            matrix.parse(matrix_text);
+
+            quantum_changed = quantum != engine_quantum.load();
+            const auto gains = ChannelGains::parse(gains_text);
+
+            const auto rebuild =
+                block_size > 0 &&
+                (matrix.getNumOutputs() > send_buf_channels || quantum_changed);
+            auto next = rebuild
+                            ? makeBuffers(jmax(send_buf_channels,
+                                               matrix.getNumOutputs()),
+                                          quantum,
+                                          recv_sync_slot >= 0 || recv_timeline)
+                            : Buffers{};
+
+            audio_lock.enter();
+            engine_quantum = quantum;
+            send_host_timecode = host_timecode;
+            send_gains.setTargets(gains);
+            if (rebuild)
+                useBuffers(next);
+            send_matrix = &matrix;
+            send_lossless_on = lossless;
+            audio_lock.exit();
         }
 
-        text_mutex.unlock();
+        prepareSendLossless();
+
+        // FIFO delays output by one quantum
+        if (quantum_changed)
+            setLatencySamples(quantum);
 
         if (s.isEmpty() || getNDISendName().isEmpty())
         {
@@ -224,59 +591,395 @@ public:
         }
     }
 
-    NDIlib_send_instance_t getNDISend()
+    bool hasNDISend()
     {
-        return ndi_send;
+        std::scoped_lock lock{send_mutex};
+        return ndi_send != nullptr;
     }
 
+    // receivers connected to sender, all split parts together, -1 if unknown
+    int getSendConnections() const
+    {
+        return send_connections.load(std::memory_order_relaxed);
+    }
+
+    // time send was skipped for lack of receivers since sender was created
+    double getSendIdleSeconds() const
+    {
+        return sample_rate > 0.0
+                   ? (double)send_idle_samples.load(std::memory_order_relaxed) /
+                         sample_rate
+                   : 0.0;
+    }
+
+    double getSendIdleRatio() const
+    {
+        auto total = send_total_samples.load(std::memory_order_relaxed);
+        return total > 0
+                   ? (double)send_idle_samples.load(std::memory_order_relaxed) /
+                         (double)total
+                   : 0.0;
+    }
+
+    // nullptr until runtime is loaded
     const NDIlib_v5 *getNDILib()
     {
-        return p_NDILib;
+        return isNdiReady() ? p_NDILib : nullptr;
+    }
+
+    RuntimeState getRuntimeState() const
+    {
+        return runtime_state.load();
     }
 
 private:
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NdiAudioProcessor)
-    static std::mutex init_mutex;
+    static AudioThreadGuard::Mutex init_mutex;
 
     double sample_rate{};
 
     AudioProcessorValueTreeState apvts;
 
+    // written once by restore queue before runtime_state turns ready
     const NDIlib_v5 *p_NDILib = nullptr;
-
     NDIlib_find_instance_t ndi_find = nullptr;
-    NDIlib_framesync_instance_t ndi_framesync = nullptr;
-    NDIlib_recv_instance_t ndi_recv = nullptr;
+    std::atomic<RuntimeState> runtime_state{RuntimeState::loading};
+
+    // set by first prepareToPlay, nothing is loaded or connected before
+    std::atomic<bool> started{false};
+    void start();
+
+    bool isNdiReady() const
+    {
+        return runtime_state.load(std::memory_order_acquire) ==
+               RuntimeState::ready;
+    }
+
+    bool loadRuntime();
+    void ensureRuntime();
+    void postConnect();
+
     NDIlib_send_instance_t ndi_send = nullptr;
 
+    // backup is hot standby, connected and pulled in parallel with primary
+    NdiRecvConnection recv_conn{};
+    NdiRecvConnection recv_backup_conn{};
+    NdiRecvPool recv_pool{};
+
     NDIlib_audio_frame_v2_t recv_audio_frame{};
+    NDIlib_audio_frame_v2_t recv_backup_audio_frame{};
     NDIlib_audio_frame_v2_t send_audio_frame{};
     NDIlib_find_create_t ndi_find_create{};
-    NDIlib_recv_create_v3_t ndi_recv_create{};
-    NDIlib_send_create_t ndi_send_create{};
 
-    std::vector<float> recv_buf{};
-    std::vector<float> send_buf{};
+    // audio thread buffers, carved out of arena in prepareToPlay
+    // and again when text inputs change sizes, under text_mutex
+    AudioArena arena{};
+    float *recv_buf = nullptr;
+    float *send_buf = nullptr;
+    int send_buf_channels{0};
+    int block_size{0};
+    // samples per channel the buffers hold, set with them under audio_lock
+    int buffer_block_size{0};
+
+    // fixed quantum engine, host block is swapped through quantum buffer:
+    // host gets output of previous quantum while quantum buffer collects input
+    std::atomic<int> engine_quantum{0};
+    AudioBuffer<float> quantum_float{};
+    AudioBuffer<double> quantum_double{};
+    int quantum_pos{0};
 
     String ndi_recv_name{};
+    String ndi_recv_backup_name{};
     String ndi_send_name{};
 
     String recv_text_input{};
     String send_text_input{};
 
+    // receive options for the next createRecv, under text_mutex like the
+    // names, createSend and createRecv copy them before connecting
+    NdiRecvProfile recv_profile{};
+
     StringArray groups{};
-    Array<int> recv_channels{};
-    // std::vector<int> recv_channels {};
+    std::array<int, MAX_CHANNELS> recv_channels{};
+    int num_recv_channels{0};
+
+    // failover state, audio thread only except recv_on_backup_shared
+    int recv_revert_ms{FAILOVER_REVERT_MS};
+    int recv_primary_ok_samples{0};
+    bool recv_primary_seen{false};
+    bool recv_on_backup{false};
+    std::atomic<bool> recv_on_backup_shared{false};
+
+    OfflineRecv recv_offline{OfflineRecv::silence};
+
+    // adaptive buffer depth, settings and state under audio_lock
+    JitterControl recv_jitter{};
+
+    // dropout concealment, history carved from arena, under audio_lock
+    bool recv_conceal{true};
+    LossConcealer recv_concealer{};
 
     bool is_standalone{false};
 
     bool send_ok{false};
     bool recv_ok{false};
 
-    SpinLock parameter_lock{};
-    SpinLock audio_lock{};
-    std::mutex text_mutex;
+    // polled by worker thread, audio thread skips send while zero
+    std::atomic<int> send_connections{-1};
+
+    // render mode changed, worker recreates the sender
+    std::atomic<bool> send_mode_changed{false};
+    std::atomic<int64> send_idle_samples{0};
+    std::atomic<int64> send_total_samples{0};
+    bool send_resume{false};
+
+    // unclocked while rendering offline, frames carry sample position
+    // timecode then (and always with split parts)
+    bool send_clocked{true};
+    int64 send_timecode_samples{0};
+    int64 send_timecode_base{0};
+    bool send_host_timecode{false};
+
+    // host timeline of the first sample processQuantum gets, -1 while the
+    // host transport is not playing
+    int64 block_timeline{-1};
+
+    // device time of that sample on the sync group clock, -1 if unknown
+    int64 block_device_time{-1};
+    int64 getDeviceTime(uint64 host_time_ns) const;
+
+    // channel activity bitmap, sent as metadata frame on change and 1/s
+    std::atomic<bool> send_activity_on{false};
+    std::atomic<int> send_activity_hold_ms{ACTIVITY_HOLD_MS};
+    int *send_activity_hold = nullptr; // samples left per channel, arena
+    int send_activity_refresh{0};
+    ChannelActivity::Mask send_activity_mask{};
+    std::array<char, 192> send_activity_xml{};
+    NDIlib_metadata_frame_t send_activity_frame{};
+    std::array<float, MAX_CHANNELS> send_peak{}; // this block, from copy pass
+
+    // last bitmap received from each source, written by worker thread
+    ChannelActivity recv_activity{};
+    ChannelActivity recv_backup_activity{};
+
+    // codec=lossless source "<name>.lossless" next to ndi_send, same
+    // lifetime rules. Receivers polled like those of ndi_send.
+    NDIlib_send_instance_t send_coded = nullptr;
+    std::atomic<int> send_coded_connections{0};
+
+    // receive the codec=lossless source of ndi_recv_name, text state
+    bool recv_coded{false};
+
+    // split sender, ndi_send carries part 1, these parts 2..K
+    int send_split_parts{1};
+    std::array<NDIlib_send_instance_t, SplitStreams::max_parts - 1>
+        send_split{};
+    int num_send_split{0};
+
+    // split source, recv_conn is part 1, these parts 2..K
+    int recv_split_parts{1};
+    std::array<NdiRecvConnection, SplitStreams::max_parts - 1> recv_split{};
+    std::array<NDIlib_audio_frame_v2_t, SplitStreams::max_parts - 1>
+        recv_split_frames{};
+    std::array<int, SplitStreams::max_parts> recv_split_lag_blocks{};
+    int num_recv_split{0};
+
+    // delay follows the sender timeline instead of sync group when set
+    bool recv_timeline{false};
+
+    // sync group membership, slot and delay state read under audio_lock
+    SharedResourcePointer<SyncGroups> sync_groups{};
+    String recv_sync_group{};
+    int recv_sync_slot{-1};
+    float *recv_sync_buf = nullptr; // arena
+    SyncDelay recv_sync_delay{};
+    double recv_sync_age{0.0};
+    int recv_sync_delay_samples{0};
+    int recv_sync_settle{0};
+    std::atomic<int> recv_sync_delay_shared{-1};
+
+    // inputs to NDI channels, audio thread reads send_matrix under audio_lock
+    std::array<SendMatrix, 2> send_matrices{};
+    SendMatrix *send_matrix = &send_matrices[0];
+
+    LevelMeter send_meter{};
+    LevelMeter recv_meter{};
+
+    // health counters for monitoring agents, published by worker thread
+    BlockMetrics block_metrics{};
+    MetricsExport metrics{};
+    uint32 metrics_next_ms{0};
+
+    // per NDI channel and per output, targets set under audio_lock
+    ChannelGains send_gains{};
+    ChannelGains recv_gains{};
+
+    // connection changes one at a time, held across NDI create and destroy.
+    // Never taken on the audio thread, so a mutex waiters sleep on.
+    Trace::Mutex<AudioThreadGuard::Mutex> parameter_lock{"parameter_lock"};
+    Trace::Lock<AudioThreadGuard::Lock<SpinLock>> audio_lock{"audio_lock"};
+    Trace::Mutex<AudioThreadGuard::Mutex> text_mutex{"text_mutex"};
+    // ndi_send lifetime vs worker
+    Trace::Mutex<AudioThreadGuard::Mutex> send_mutex{"send_mutex"};
+    // recv_conn lifetime vs worker
+    Trace::Mutex<AudioThreadGuard::Mutex> recv_mutex{"recv_mutex"};
+    // create and release one at a time, taken before the others
+    Trace::Mutex<AudioThreadGuard::Mutex> connect_mutex{"connect_mutex"};
+    // send_lossless.prepare one at a time, taken before text_mutex
+    Trace::Mutex<AudioThreadGuard::Mutex> lossless_mutex{"lossless_mutex"};
+
+    // what recv_conn was connected for, under connect_mutex
+    struct RecvTarget
+    {
+        String source{};
+        String backup{};
+        String recv_name{};
+        int parts{1};
+        bool coded{false};
+        NdiRecvProfile profile{};
+
+        bool operator==(const RecvTarget &other) const
+        {
+            return source == other.source && backup == other.backup &&
+                   recv_name == other.recv_name && parts == other.parts &&
+                   coded == other.coded && profile == other.profile;
+        }
+    };
+    RecvTarget recv_target{};
+
+    // codec=lossless, blocks also go out coded on send_coded while it has
+    // receivers. send_lossless_on under audio_lock.
+    bool send_lossless_on{false};
+    LosslessSender send_lossless{
+        [this](const char *xml, int64 timecode)
+        { sendLossless(xml, timecode); },
+        [this](const NDIlib_audio_frame_v2_t &frame)
+        { sendLosslessAudio(frame); }};
+
+    // encoder for the current text input and block size. Waits for the
+    // encoder, so not under text_mutex; the latest state wins when text
+    // inputs and prepareToPlay race.
+    void prepareSendLossless()
+    {
+        std::scoped_lock lossless_lock{lossless_mutex};
+        auto channels = 0;
+        auto block = 0;
+        {
+            std::scoped_lock lock{text_mutex};
+            channels = send_lossless_on ? send_buf_channels : 0;
+            block = jmax(block_size, engine_quantum.load());
+        }
+        send_lossless.prepare(channels, block);
+    }
+
+    // packets of the primary source, replace its frame-sync audio
+    LosslessReceiver recv_lossless{};
+
+    // next audio thread buffers, allocated and carved off the audio thread
+    // and swapped in under audio_lock
+    struct Buffers
+    {
+        AudioArena arena{};
+        AudioBuffer<float> quantum_float{};
+        AudioBuffer<double> quantum_double{};
+        float *recv = nullptr;
+        float *send = nullptr;
+        int block = 0;
+        int send_channels = 0;
+        int *activity_hold = nullptr;
+        float *sync = nullptr;
+        float *conceal = nullptr;
+    };
+
+    Buffers makeBuffers(int send_channels, int quantum, bool delayed) const;
+    void useBuffers(Buffers &next);
+
+    void createRecv();
+    void releaseRecv();
+
+    void createSend();
+    void destroySend();
+
+    void timerCallback() override;
+    int useTimeSlice() override;
+    void pollSendMode();
+    int pollSendConnections();
+    int pollRecvMetadata();
+    int publishMetrics();
+
+    void sendChannelActivity(int numChannels, int numSamples, int sampleRate);
+    void sendLossless(const char *xml, int64 timecode);
+    void sendLosslessAudio(const NDIlib_audio_frame_v2_t &frame);
+
+    SharedResourcePointer<NdiWorkerThread> worker{};
+
+    // connections of a loaded session are created here, not on loading thread
+    SharedResourcePointer<NdiRestoreQueue> restore_queue{};
+
+    // applied on control server thread, same path as the editor text input
+    SharedResourcePointer<ControlServer> control{};
+    std::atomic<int> control_id{0};
+
+    String getControlSendText() override
+    {
+        return getNDISendTextInput();
+    }
+
+    String getControlRecvText() override
+    {
+        return getNDIRecvTextInput();
+    }
+
+    void applyControlSendText(const String &text) override
+    {
+        parseSendTextInput(text);
+        parameterChanged("send", apvts.getRawParameterValue("send")->load());
+    }
+
+    void applyControlRecvText(const String &text) override
+    {
+        parseRecvTextInput(text);
+        parameterChanged("recv", apvts.getRawParameterValue("recv")->load());
+    }
+
+    bool selectRecvBackup(bool primary_ok, bool backup_ok, int numSamples,
+                          int sampleRate);
+    void alignRecvSplit(int sampleRate);
+    bool pullOfflineRecv(int numSamples);
+
+    void setRecvSyncGroup(const String &group);
+
+    template <typename T>
+    void processQuantum(const T *const *inputs, int numInputs,
+                        T *const *outputs, int numOutputs, int numSamples);
+
+    template <typename T>
+    void alignRecvTimeline(T *const *outputs,
+                           NDIlib_framesync_instance_t framesync,
+                           const NDIlib_audio_frame_v2_t &frame,
+                           int numChannels, int numSamples, int sampleRate);
+
+    template <typename T>
+    void syncRecvGroup(T *const *outputs,
+                       const NDIlib_audio_frame_v2_t &frame, int numChannels,
+                       int numSamples, int sampleRate);
+
+    // key=value pairs separated by commas, values may be quoted
+    static StringPairArray parseOptions(const String &s)
+    {
+        StringPairArray options{};
+        auto t = StringArray::fromTokens(s, ",", "\"");
+        t.trim();
+        t.removeEmptyStrings();
+        for (auto &&k : t)
+        {
+            auto key = k.upToFirstOccurrenceOf("=", false, false).trim();
+            auto value = k.fromFirstOccurrenceOf("=", false, false).trim();
+            options.set(key.toLowerCase(), value.unquoted().trim());
+        }
+        return options;
+    }
 
 #if _WIN32
     HMODULE hNDILib;
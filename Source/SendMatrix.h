@@ -0,0 +1,199 @@
+#pragma once
+#include <JuceHeader.h>
+
+#include "AudioKernels.h"
+
+#include <array>
+#include <cmath>
+
+// send routing from plugin inputs to NDI channels, compiled to a sparse tap
+// list. NDI channel k is the sum of gain * input over its taps.
+//
+// text form, one comma separated entry per NDI channel:
+//   3          input 3
+//   1-4        inputs 1 to 4 on four NDI channels
+//   1@-6+2@-6  inputs 1 and 2 summed at -6 dB each
+//   0          silent channel
+// empty text sends inputs as they are
+class SendMatrix
+{
+  public:
+    static constexpr int max_outputs = 256;
+    static constexpr int max_taps = 1024;
+
+    struct Tap
+    {
+        int input = 0; // zero based
+        float gain = 1.0f;
+    };
+
+    struct Output
+    {
+        int first = 0;
+        int count = 0; // zero is silence
+        bool copy = false; // single unity tap
+    };
+
+    enum class Mode
+    {
+        identity,    // no matrix, inputs in order
+        permutation, // every channel a plain copy or silence
+        mix
+    };
+
+    // message thread, returns false if text had to be truncated
+    bool parse(const String &s)
+    {
+        num_outputs = 0;
+        num_taps = 0;
+        max_input = -1;
+        mode = Mode::identity;
+
+        auto entries = StringArray::fromTokens(s, ",", "");
+        entries.trim();
+        entries.removeEmptyStrings();
+        if (entries.isEmpty())
+            return true;
+
+        auto ok = true;
+        for (auto &&e : entries)
+        {
+            if (!ok)
+                break;
+
+            // range of unity channels
+            if (!e.containsAnyOf("+@") && e.indexOf(1, "-") > 0)
+            {
+                auto first = e.upToFirstOccurrenceOf("-", false, false)
+                                 .getIntValue();
+                auto last = e.fromFirstOccurrenceOf("-", false, false)
+                                .getIntValue();
+                for (auto i = first; ok && i > 0 && i <= last; i++)
+                    ok = addOutput() && addTap(i - 1, 1.0f);
+                continue;
+            }
+
+            ok = addOutput();
+            if (!ok)
+                break;
+
+            auto terms = StringArray::fromTokens(e, "+", "");
+            terms.trim();
+            terms.removeEmptyStrings();
+            for (auto &&t : terms)
+            {
+                auto input = t.upToFirstOccurrenceOf("@", false, false)
+                                 .getIntValue();
+                auto gain = 1.0f;
+                if (t.containsChar('@'))
+                {
+                    auto db =
+                        t.fromFirstOccurrenceOf("@", false, false).trim();
+                    gain = db.startsWithIgnoreCase("-inf")
+                               ? 0.0f
+                               : std::pow(10.0f, db.getFloatValue() / 20.0f);
+                }
+
+                if (input > 0 && gain != 0.0f)
+                    ok = addTap(input - 1, gain) && ok;
+            }
+        }
+
+        // plain copies unless some channel mixes or scales
+        mode = Mode::permutation;
+        for (auto i = 0; i < num_outputs; i++)
+        {
+            auto &o = outputs[(size_t)i];
+            o.copy = o.count == 1 && taps[(size_t)o.first].gain == 1.0f;
+            if (o.count > 1 || (o.count == 1 && !o.copy))
+                mode = Mode::mix;
+        }
+
+        return ok;
+    }
+
+    Mode getMode() const
+    {
+        return mode;
+    }
+
+    int getNumOutputs() const
+    {
+        return num_outputs;
+    }
+
+    // highest input referenced, -1 if none
+    int getMaxInput() const
+    {
+        return max_input;
+    }
+
+    // audio thread, renders NDI channel into dst with channel gain on top
+    // and measures it. Taps on inputs the host does not provide are silent.
+    template <typename T>
+    AudioKernels::Levels process(int output, const T *const *inputs,
+                                 int numInputs, float *dst, int numSamples,
+                                 AudioKernels::Ramp gain = {}) const
+    {
+        const auto &o = outputs[(size_t)output];
+
+        if (o.copy && taps[(size_t)o.first].input < numInputs)
+            return AudioKernels::copyGainMeasure(
+                inputs[taps[(size_t)o.first].input], dst, numSamples, gain);
+
+        auto mixed = 0;
+        AudioKernels::Levels levels{};
+        for (auto i = o.first; i < o.first + o.count; i++)
+        {
+            const auto &t = taps[(size_t)i];
+            if (t.input >= numInputs)
+                continue;
+
+            const AudioKernels::Ramp tap_gain{t.gain * gain.start,
+                                              t.gain * gain.step};
+            if (mixed++ == 0)
+                levels = AudioKernels::copyGainMeasure(inputs[t.input], dst,
+                                                       numSamples, tap_gain);
+            else
+                AudioKernels::multiplyAdd(inputs[t.input], dst, tap_gain,
+                                          numSamples);
+        }
+
+        if (mixed == 0)
+        {
+            std::fill_n(dst, numSamples, 0.0f);
+            return {};
+        }
+
+        return mixed == 1 ? levels : AudioKernels::measure(dst, numSamples);
+    }
+
+  private:
+    bool addOutput()
+    {
+        if (num_outputs >= max_outputs)
+            return false;
+
+        outputs[(size_t)num_outputs++] = {num_taps, 0, false};
+        return true;
+    }
+
+    // adds tap to last output
+    bool addTap(int input, float gain)
+    {
+        if (num_outputs == 0 || num_taps >= max_taps)
+            return false;
+
+        taps[(size_t)num_taps++] = {input, gain};
+        outputs[(size_t)num_outputs - 1].count++;
+        max_input = jmax(max_input, input);
+        return true;
+    }
+
+    std::array<Output, max_outputs> outputs{};
+    std::array<Tap, max_taps> taps{};
+    int num_outputs = 0;
+    int num_taps = 0;
+    int max_input = -1;
+    Mode mode = Mode::identity;
+};
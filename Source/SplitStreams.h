@@ -0,0 +1,35 @@
+#pragma once
+#include <JuceHeader.h>
+
+// wide feed carried as parallel NDI streams, each with its own sender and
+// transport. Channels are split in contiguous blocks, part k is announced as
+// "<name>.k" (1 based). Every part of a block carries the same timecode, the
+// receiver lines parts up on it.
+namespace SplitStreams
+{
+constexpr int max_parts = 8;
+
+// "MACHINE (Sender)" -> "MACHINE (Sender.2)", "Sender" -> "Sender.2"
+inline String getPartName(const String &name, int part)
+{
+    auto suffix = "." + String(part);
+    if (name.endsWithChar(')'))
+        return name.dropLastCharacters(1) + suffix + ")";
+    return name + suffix;
+}
+
+// first channel of part, parts are ceil(channels / parts) wide, so
+// getPartFirst(channels, parts, parts) == channels
+inline int getPartFirst(int channels, int parts, int part)
+{
+    auto width = (channels + parts - 1) / parts;
+    return jmin(channels, width * part);
+}
+
+// running sample count to NDI timecode (100 ns) without overflow
+inline int64 toTimecode(int64 samples, int sampleRate)
+{
+    return samples / sampleRate * 10000000 +
+           samples % sampleRate * 10000000 / sampleRate;
+}
+} // namespace SplitStreams
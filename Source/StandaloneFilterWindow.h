@@ -26,6 +26,7 @@
 #pragma once
 
 #include "CustomLookAndFeel.h"
+#include "DeviceBridge.h"
 #include <JuceHeader.h>
 
 #ifndef DOXYGEN
@@ -94,6 +95,7 @@ class StandalonePluginHolder : private AudioIODeviceCallback,
     {
         shouldMuteInput.addListener(this);
         shouldMuteInput = !isInterAppAudioConnected();
+        shouldUseDeviceBridge.addListener(this);
 
         createPlugin();
 
@@ -189,12 +191,23 @@ class StandalonePluginHolder : private AudioIODeviceCallback,
     {
         return shouldMuteInput;
     }
+    Value& getDeviceBridgeValue()
+    {
+        return shouldUseDeviceBridge;
+    }
     bool getProcessorHasPotentialFeedbackLoop() const
     {
         return processorHasPotentialFeedbackLoop;
     }
     void valueChanged(Value& value) override
     {
+        if (value.refersToSameSourceAs(shouldUseDeviceBridge))
+        {
+            if (player.getCurrentProcessor() != nullptr)
+                publishBridge();
+            return;
+        }
+
         muteInput = (bool)value.getValue();
     }
 
@@ -286,6 +299,7 @@ class StandalonePluginHolder : private AudioIODeviceCallback,
     void startPlaying()
     {
         player.setProcessor(processor.get());
+        publishBridge();
 
 #if JucePlugin_Enable_IAA && JUCE_IOS
         if (auto device = dynamic_cast<iOSAudioIODevice*>(
@@ -299,9 +313,29 @@ class StandalonePluginHolder : private AudioIODeviceCallback,
 
     void stopPlaying()
     {
+        bridge.store(nullptr);
+        waitForBridgeUsers();
+
         player.setProcessor(nullptr);
     }
 
+    // the device callback finds the processor through bridge while the
+    // option is on. A replaced one may still be in use by a callback that
+    // loaded it before, wait for that to return before it can go away.
+    void publishBridge()
+    {
+        bridge.store((bool)shouldUseDeviceBridge.getValue()
+                         ? dynamic_cast<DeviceBridge*>(processor.get())
+                         : nullptr);
+        waitForBridgeUsers();
+    }
+
+    void waitForBridgeUsers()
+    {
+        while (bridgeUsers.load() > 0)
+            Thread::yield();
+    }
+
     //==============================================================================
     /** Shows an audio properties dialog box modally. */
     void showAudioSettingsDialog()
@@ -353,6 +387,8 @@ class StandalonePluginHolder : private AudioIODeviceCallback,
             settings->setValue("shouldMuteInput",
                                (bool)shouldMuteInput.getValue());
 #endif
+            settings->setValue("shouldUseDeviceBridge",
+                               (bool)shouldUseDeviceBridge.getValue());
         }
     }
 
@@ -370,6 +406,8 @@ class StandalonePluginHolder : private AudioIODeviceCallback,
             shouldMuteInput.setValue(
                 settings->getBoolValue("shouldMuteInput", true));
 #endif
+            shouldUseDeviceBridge.setValue(
+                settings->getBoolValue("shouldUseDeviceBridge", false));
         }
 
         auto inputChannels = getNumInputChannels();
@@ -463,6 +501,13 @@ class StandalonePluginHolder : private AudioIODeviceCallback,
     AudioBuffer<float> emptyBuffer;
     bool autoOpenMidiDevices;
 
+    // device-to-NDI fast path, bypasses player while the processor takes it.
+    // Opt-in, off by default. bridgeUsers counts callbacks between loading
+    // bridge and returning from it, no lock on the device callback.
+    Value shouldUseDeviceBridge;
+    std::atomic<DeviceBridge*> bridge {nullptr};
+    std::atomic<int> bridgeUsers {0};
+
     std::unique_ptr<AudioDeviceManager::AudioDeviceSetup> options;
     Array<MidiDeviceInfo> lastMidiDevices;
 
@@ -494,6 +539,7 @@ class StandalonePluginHolder : private AudioIODeviceCallback,
         void audioDeviceAboutToStart(AudioIODevice* device) override
         {
             maximumSize = device->getCurrentBufferSizeSamples();
+            sampleRate = device->getCurrentSampleRate();
             storedInputChannels.resize((size_t)device->getActiveInputChannels()
                                            .countNumberOfSetBits());
             storedOutputChannels.resize(
@@ -524,10 +570,22 @@ class StandalonePluginHolder : private AudioIODeviceCallback,
                 initChannelPointers(outputChannelData, storedOutputChannels,
                                     position);
 
+                // device time of this part of the block
+                auto partContext = context;
+                uint64_t partHostTimeNs = 0;
+                if (context.hostTimeNs != nullptr && sampleRate > 0.0)
+                {
+                    partHostTimeNs =
+                        *context.hostTimeNs +
+                        (uint64_t)((double)position * 1.0e9 / sampleRate);
+                    partContext.hostTimeNs = &partHostTimeNs;
+                }
+
                 inner.audioDeviceIOCallbackWithContext(
                     storedInputChannels.data(), (int)storedInputChannels.size(),
                     storedOutputChannels.data(),
-                    (int)storedOutputChannels.size(), blockLength, context);
+                    (int)storedOutputChannels.size(), blockLength,
+                    partContext);
 
                 position += blockLength;
             }
@@ -559,6 +617,7 @@ class StandalonePluginHolder : private AudioIODeviceCallback,
 
         AudioIODeviceCallback& inner;
         int maximumSize = 0;
+        double sampleRate = 0.0;
         std::vector<const float*> storedInputChannels;
         std::vector<float*> storedOutputChannels;
     };
@@ -670,6 +729,20 @@ class StandalonePluginHolder : private AudioIODeviceCallback,
         float* const* outputChannelData, int numOutputChannels, int numSamples,
         const AudioIODeviceCallbackContext& context) override
     {
+        {
+            // seq_cst, publishBridge sees the count once its store is visible
+            bridgeUsers.fetch_add(1);
+            auto* b = bridge.load();
+            const auto bridged =
+                b != nullptr &&
+                b->processDeviceBlock(inputChannelData, numInputChannels,
+                                      outputChannelData, numOutputChannels,
+                                      numSamples, context.hostTimeNs);
+            bridgeUsers.fetch_sub(1);
+            if (bridged)
+                return;
+        }
+
         if (muteInput)
         {
             emptyBuffer.clear();
@@ -919,6 +992,12 @@ class StandaloneFilterWindow : public DocumentWindow, private Button::Listener
         case 4:
             resetToDefaultState();
             break;
+        case 5:
+        {
+            auto& v = pluginHolder->getDeviceBridgeValue();
+            v.setValue(!(bool)v.getValue());
+            break;
+        }
         default:
             break;
         }
@@ -967,6 +1046,9 @@ class StandaloneFilterWindow : public DocumentWindow, private Button::Listener
         m.addItem(3, TRANS("Load a saved state..."));
         m.addSeparator();
         m.addItem(4, TRANS("Reset to default state"));
+        m.addSeparator();
+        m.addItem(5, TRANS("Direct device bridge"), true,
+                  (bool)pluginHolder->getDeviceBridgeValue().getValue());
 
         m.showMenuAsync(
             PopupMenu::Options(),
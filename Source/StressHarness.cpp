@@ -0,0 +1,627 @@
+#include "StressHarness.h"
+
+#if NDI_AUDIO_IO_STRESS
+#include "PluginProcessor.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+//==============================================================================
+// loopback runtime, every receiver of "LOCAL (name)" reads what sender name
+// sent. One lock for everything, the harness is about the processor.
+constexpr int loop_channels = 16;
+constexpr std::int64_t loop_length = 1 << 16; // samples, power of two
+
+struct Sender
+{
+    std::string name;
+    NDIlib_source_t source{};
+    std::vector<float> ring =
+        std::vector<float>((size_t)(loop_channels * loop_length));
+    int channels = 0;
+    int sample_rate = 48000;
+    std::int64_t written = 0;
+};
+
+struct Receiver
+{
+    std::string source;
+};
+
+struct FrameSync
+{
+    Receiver* recv;
+    std::int64_t read = -1;
+};
+
+std::mutex loop_mutex{};
+std::vector<std::unique_ptr<Sender>> senders{};
+std::vector<Receiver*> receivers{};
+
+// caller holds loop_mutex
+Sender* findSender(const std::string& name)
+{
+    for (auto&& s : senders)
+    {
+        if (s->name == name)
+            return s.get();
+    }
+    return nullptr;
+}
+
+bool initialize()
+{
+    return true;
+}
+
+void destroy()
+{
+}
+
+NDIlib_find_instance_t findCreate(const NDIlib_find_create_t*)
+{
+    static int find{};
+    return reinterpret_cast<NDIlib_find_instance_t>(&find);
+}
+
+void findDestroy(NDIlib_find_instance_t)
+{
+}
+
+// list stays valid until the calling thread asks again
+const NDIlib_source_t* findSources(NDIlib_find_instance_t, uint32_t* count)
+{
+    thread_local std::vector<std::string> names{};
+    thread_local std::vector<NDIlib_source_t> found{};
+    {
+        std::scoped_lock lock{loop_mutex};
+        names.clear();
+        for (auto&& s : senders)
+            names.push_back(s->name);
+    }
+    found.assign(names.size(), NDIlib_source_t{});
+    for (size_t i = 0; i < names.size(); i++)
+        found[i].p_ndi_name = names[i].c_str();
+
+    *count = (uint32_t)found.size();
+    return found.data();
+}
+
+NDIlib_send_instance_t sendCreate(const NDIlib_send_create_t* create)
+{
+    auto s = std::make_unique<Sender>();
+    s->name = std::string("LOCAL (") +
+              (create && create->p_ndi_name ? create->p_ndi_name : "") + ")";
+    s->source.p_ndi_name = s->name.c_str();
+
+    std::scoped_lock lock{loop_mutex};
+    senders.push_back(std::move(s));
+    return reinterpret_cast<NDIlib_send_instance_t>(senders.back().get());
+}
+
+void sendDestroy(NDIlib_send_instance_t instance)
+{
+    std::scoped_lock lock{loop_mutex};
+    for (auto it = senders.begin(); it != senders.end(); ++it)
+    {
+        if (reinterpret_cast<NDIlib_send_instance_t>(it->get()) == instance)
+        {
+            senders.erase(it);
+            return;
+        }
+    }
+}
+
+void sendAudio(NDIlib_send_instance_t instance,
+               const NDIlib_audio_frame_v2_t* frame)
+{
+    auto s = reinterpret_cast<Sender*>(instance);
+    if (frame == nullptr || frame->p_data == nullptr)
+        return;
+
+    std::scoped_lock lock{loop_mutex};
+    s->channels = jmin(frame->no_channels, loop_channels);
+    s->sample_rate = frame->sample_rate;
+    const auto stride = frame->channel_stride_in_bytes / (int)sizeof(float);
+    for (auto c = 0; c < s->channels; c++)
+    {
+        auto dst = s->ring.data() + (size_t)c * (size_t)loop_length;
+        auto src = frame->p_data + (size_t)c * (size_t)stride;
+        for (auto i = 0; i < frame->no_samples; i++)
+            dst[(s->written + i) & (loop_length - 1)] = src[i];
+    }
+    s->written += frame->no_samples;
+}
+
+void sendMetadata(NDIlib_send_instance_t, const NDIlib_metadata_frame_t*)
+{
+}
+
+int sendConnections(NDIlib_send_instance_t instance, uint32_t)
+{
+    std::scoped_lock lock{loop_mutex};
+    auto s = reinterpret_cast<Sender*>(instance);
+    auto n = 0;
+    for (auto r : receivers)
+    {
+        if (r->source == s->name)
+            n++;
+    }
+    return n;
+}
+
+const NDIlib_source_t* sendSourceName(NDIlib_send_instance_t instance)
+{
+    return &reinterpret_cast<Sender*>(instance)->source;
+}
+
+NDIlib_recv_instance_t recvCreate(const NDIlib_recv_create_v3_t* create)
+{
+    auto r = new Receiver{};
+    if (create && create->source_to_connect_to.p_ndi_name)
+        r->source = create->source_to_connect_to.p_ndi_name;
+
+    std::scoped_lock lock{loop_mutex};
+    receivers.push_back(r);
+    return reinterpret_cast<NDIlib_recv_instance_t>(r);
+}
+
+void recvDestroy(NDIlib_recv_instance_t instance)
+{
+    auto r = reinterpret_cast<Receiver*>(instance);
+    {
+        std::scoped_lock lock{loop_mutex};
+        receivers.erase(std::find(receivers.begin(), receivers.end(), r));
+    }
+    delete r;
+}
+
+void recvAddMetadata(NDIlib_recv_instance_t, const NDIlib_metadata_frame_t*)
+{
+}
+
+NDIlib_frame_type_e recvCapture(NDIlib_recv_instance_t,
+                                NDIlib_video_frame_v2_t*,
+                                NDIlib_audio_frame_v3_t*,
+                                NDIlib_metadata_frame_t*, uint32_t)
+{
+    return NDIlib_frame_type_none;
+}
+
+void recvFreeMetadata(NDIlib_recv_instance_t, const NDIlib_metadata_frame_t*)
+{
+}
+
+NDIlib_framesync_instance_t frameSyncCreate(NDIlib_recv_instance_t recv)
+{
+    auto fs = new FrameSync{reinterpret_cast<Receiver*>(recv)};
+    return reinterpret_cast<NDIlib_framesync_instance_t>(fs);
+}
+
+void frameSyncDestroy(NDIlib_framesync_instance_t instance)
+{
+    delete reinterpret_cast<FrameSync*>(instance);
+}
+
+// caller holds loop_mutex, samples queued for frame-sync
+std::int64_t queued(FrameSync* fs, Sender* s)
+{
+    if (s == nullptr || fs->read < 0)
+        return 0;
+
+    // overrun, start over half a ring behind
+    if (s->written - fs->read > loop_length)
+        fs->read = s->written - loop_length / 2;
+    return s->written - fs->read;
+}
+
+// no sample rate conversion, silence pads what the sender has not sent
+void frameSyncCapture(NDIlib_framesync_instance_t instance,
+                      NDIlib_audio_frame_v2_t* frame, int sample_rate,
+                      int channels, int samples)
+{
+    auto fs = reinterpret_cast<FrameSync*>(instance);
+    *frame = NDIlib_audio_frame_v2_t{};
+
+    std::scoped_lock lock{loop_mutex};
+    auto s = findSender(fs->recv->source);
+    if (s != nullptr && fs->read < 0)
+        fs->read = s->written;
+
+    if (channels <= 0 || samples <= 0)
+    {
+        frame->no_channels = s != nullptr ? s->channels : 0;
+        frame->sample_rate = s != nullptr ? s->sample_rate : 0;
+        return;
+    }
+
+    frame->sample_rate = sample_rate;
+    frame->no_channels = channels;
+    frame->no_samples = samples;
+    frame->channel_stride_in_bytes = samples * (int)sizeof(float);
+    frame->p_data = new float[(size_t)channels * (size_t)samples]{};
+
+    const auto n = (int)jmin((std::int64_t)samples, queued(fs, s));
+    for (auto c = 0; c < jmin(channels, s != nullptr ? s->channels : 0); c++)
+    {
+        auto src = s->ring.data() + (size_t)c * (size_t)loop_length;
+        auto dst = frame->p_data + (size_t)c * (size_t)samples;
+        for (auto i = 0; i < n; i++)
+            dst[i] = src[(fs->read + i) & (loop_length - 1)];
+    }
+    fs->read += n;
+}
+
+void frameSyncFree(NDIlib_framesync_instance_t, NDIlib_audio_frame_v2_t* frame)
+{
+    delete[] frame->p_data;
+    frame->p_data = nullptr;
+}
+
+int frameSyncDepth(NDIlib_framesync_instance_t instance)
+{
+    auto fs = reinterpret_cast<FrameSync*>(instance);
+    std::scoped_lock lock{loop_mutex};
+    return (int)queued(fs, findSender(fs->recv->source));
+}
+
+NDIlib_v5 makeStandIn()
+{
+    NDIlib_v5 lib{};
+    lib.initialize = initialize;
+    lib.destroy = destroy;
+    lib.find_create_v2 = findCreate;
+    lib.find_destroy = findDestroy;
+    lib.find_get_current_sources = findSources;
+    lib.send_create = sendCreate;
+    lib.send_destroy = sendDestroy;
+    lib.send_send_audio_v2 = sendAudio;
+    lib.send_send_metadata = sendMetadata;
+    lib.send_get_no_connections = sendConnections;
+    lib.send_add_connection_metadata = sendMetadata;
+    lib.send_get_source_name = sendSourceName;
+    lib.recv_create_v3 = recvCreate;
+    lib.recv_destroy = recvDestroy;
+    lib.recv_add_connection_metadata = recvAddMetadata;
+    lib.recv_capture_v3 = recvCapture;
+    lib.recv_free_metadata = recvFreeMetadata;
+    lib.framesync_create = frameSyncCreate;
+    lib.framesync_destroy = frameSyncDestroy;
+    lib.framesync_capture_audio = frameSyncCapture;
+    lib.framesync_free_audio = frameSyncFree;
+    lib.framesync_audio_queue_depth = frameSyncDepth;
+    return lib;
+}
+
+//==============================================================================
+constexpr double sample_rate = 48000.0;
+constexpr int block_size = 256;
+constexpr int hammer_threads = 3;
+constexpr int max_jitter_us = 2000; // callbacks wake up late by up to this
+constexpr int bucket_us = 10;
+constexpr int num_buckets = 2048; // last one holds everything slower
+
+const char* const recv_inputs[] = {
+    "LOCAL (stress);1-2",
+    "LOCAL (stress);2,1;jitter=auto",
+    "LOCAL (stress);1-2;conceal=off,pool=0",
+    "LOCAL (stress);1-2;sync=stress",
+    "LOCAL (stress);1-2;timeline=on",
+    "LOCAL (stress);1-2;backup=LOCAL (missing)",
+    "LOCAL (stress);1-2;;-6,inv",
+    "LOCAL (missing);1-2",
+};
+
+const char* const send_inputs[] = {
+    "stress",
+    "stress;;quantum=64",
+    "stress;;activity=on,hold=100",
+    "stress;;timecode=host",
+    "stress;;;2+1,1+2",
+    "stress;;;;0,-3 inv",
+};
+
+template <size_t N>
+const char* pick(Random& random, const char* const (&inputs)[N])
+{
+    return inputs[random.nextInt((int)N)];
+}
+
+class Run
+{
+  public:
+    explicit Run(int seconds_) : seconds(seconds_)
+    {
+        processor = std::make_unique<NdiAudioProcessor>();
+        processor->setRateAndBufferSizeDetails(sample_rate, block_size);
+        processor->prepareToPlay(sample_rate, block_size);
+        processor->parseSendTextInput(send_inputs[0]);
+        processor->parseRecvTextInput(recv_inputs[0]);
+        setParameter("send", 1.0f);
+        setParameter("recv", 1.0f);
+    }
+
+    // harness thread
+    void control()
+    {
+        // runtime is loaded on the restore queue
+        using State = NdiAudioProcessor::RuntimeState;
+        for (auto i = 0; i < 1000; i++)
+        {
+            if (processor->getRuntimeState() != State::loading)
+                break;
+            Thread::sleep(10);
+        }
+
+        std::vector<std::thread> threads{};
+        threads.emplace_back([this] { audio(); });
+        for (auto i = 0; i < hammer_threads; i++)
+            threads.emplace_back([this, i] { hammer(i); });
+
+        Thread::sleep(seconds * 1000);
+        stop = true;
+        for (auto&& t : threads)
+            t.join();
+    }
+
+    // message thread, after control(), returns exit code
+    int finish()
+    {
+        processor->releaseResources();
+        processor.reset();
+
+        const auto period_us = 1.0e6 * block_size / sample_rate;
+        std::int64_t p99 = 0;
+        std::int64_t sum = 0;
+        for (auto i = 0; i < num_buckets; i++)
+        {
+            sum += histogram[(size_t)i];
+            if (sum * 100 >= blocks * 99)
+            {
+                p99 = (std::int64_t)(i + 1) * bucket_us;
+                break;
+            }
+        }
+
+        std::printf("stress: %d s, %lld blocks of %d at %.0f Hz, "
+                    "%d threads, %lld calls\n",
+                    seconds, (long long)blocks, block_size, sample_rate,
+                    hammer_threads, (long long)calls.load());
+        std::printf("block time: mean %.1f us, p99 <%lld us, worst %lld us "
+                    "(budget %.0f us)\n",
+                    blocks > 0 ? (double)total_us / (double)blocks : 0.0,
+                    (long long)p99, (long long)worst_us, period_us);
+        std::printf("late blocks: %lld\n", (long long)late);
+        std::printf("silent blocks: %lld, longest run %lld\n",
+                    (long long)silent, (long long)longest_silent);
+        std::fflush(stdout);
+
+        return heard ? 0 : 1;
+    }
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    const int seconds;
+    std::unique_ptr<NdiAudioProcessor> processor;
+    std::atomic<bool> stop{false};
+    std::atomic<std::int64_t> calls{0};
+
+    // audio thread, read after join
+    std::array<std::int64_t, num_buckets> histogram{};
+    std::int64_t blocks{0};
+    std::int64_t total_us{0};
+    std::int64_t worst_us{0};
+    std::int64_t late{0};
+    std::int64_t silent{0};
+    std::int64_t longest_silent{0};
+    bool heard{false};
+
+    void setParameter(const char* id, float value)
+    {
+        if (auto p = processor->getAPVTS().getParameter(id))
+            p->setValueNotifyingHost(value);
+    }
+
+    // host callback, sine in, received loopback out
+    void audio()
+    {
+        AudioBuffer<float> buffer{2, block_size};
+        MidiBuffer midi{};
+        Random random{};
+        const auto delta =
+            MathConstants<double>::twoPi * 440.0 / sample_rate;
+        const auto period = std::chrono::microseconds(
+            (std::int64_t)(1.0e6 * block_size / sample_rate));
+        auto phase = 0.0;
+        auto silent_run = std::int64_t{0};
+        auto deadline = Clock::now();
+
+        while (!stop)
+        {
+            for (auto i = 0; i < block_size; i++)
+            {
+                const auto x = 0.25f * (float)std::sin(phase);
+                buffer.setSample(0, i, x);
+                buffer.setSample(1, i, x);
+                phase += delta;
+            }
+            phase = std::fmod(phase, MathConstants<double>::twoPi);
+
+            const auto begin = Clock::now();
+            processor->processBlock(buffer, midi);
+            const auto end = Clock::now();
+
+            const auto us =
+                std::chrono::duration_cast<std::chrono::microseconds>(end -
+                                                                      begin)
+                    .count();
+            histogram[(size_t)jmin((std::int64_t)num_buckets - 1,
+                                   us / bucket_us)]++;
+            total_us += us;
+            worst_us = jmax(worst_us, (std::int64_t)us);
+            blocks++;
+
+            if (buffer.getMagnitude(0, block_size) == 0.0f)
+            {
+                silent++;
+                longest_silent = jmax(longest_silent, ++silent_run);
+            }
+            else
+            {
+                silent_run = 0;
+                heard = true;
+            }
+
+            // a late callback does not make the next ones early
+            deadline += period;
+            if (end > deadline)
+                late++;
+            if (end > deadline + period)
+                deadline = end;
+
+            std::this_thread::sleep_until(
+                deadline +
+                std::chrono::microseconds(random.nextInt(max_jitter_us)));
+        }
+    }
+
+    // stands in for message thread, control endpoint, host automation and
+    // editor timer at once, with random pauses between calls
+    void hammer(int index)
+    {
+        Random random{(int64)index + 1};
+        MemoryBlock state{};
+        LevelMeter::Snapshot meter{};
+        std::int64_t n = 0;
+
+        while (!stop)
+        {
+            switch (random.nextInt(9))
+            {
+            case 0:
+                processor->parseRecvTextInput(pick(random, recv_inputs));
+                break;
+            case 1:
+                processor->parseSendTextInput(pick(random, send_inputs));
+                break;
+            case 2:
+                setParameter("recv", random.nextInt(4) > 0 ? 1.0f : 0.0f);
+                break;
+            case 3:
+                setParameter("send", random.nextInt(4) > 0 ? 1.0f : 0.0f);
+                break;
+            case 4:
+                setParameter("ndi_recv", random.nextFloat());
+                break;
+            case 5:
+                // same as applyControlRecvText and applyControlSendText
+                processor->parseRecvTextInput(pick(random, recv_inputs));
+                processor->parameterChanged(
+                    "recv",
+                    processor->getAPVTS().getRawParameterValue("recv")->load());
+                processor->parseSendTextInput(pick(random, send_inputs));
+                processor->parameterChanged(
+                    "send",
+                    processor->getAPVTS().getRawParameterValue("send")->load());
+                break;
+            case 6:
+                processor->getNDISendName2();
+                processor->getNDIRecvName();
+                processor->getRecvBufferTarget();
+                processor->getRecvUnderruns();
+                processor->getRecvConcealed();
+                processor->getRecvSyncDelay();
+                processor->isRecvOnBackup();
+                processor->getSendConnections();
+                processor->getSendIdleRatio();
+                processor->hasNDISend();
+                processor->getControlId();
+                processor->isRestorePending();
+                processor->getSendMeter().read(meter);
+                processor->getRecvMeter().read(meter);
+                if (auto lib = processor->getNDILib())
+                {
+                    uint32_t sources = 0;
+                    lib->find_get_current_sources(processor->getNDIFind(),
+                                                  &sources);
+                }
+                break;
+            case 7:
+                processor->getStateInformation(state);
+                break;
+            default:
+                // hosts load sessions on the message thread
+                if (state.getSize() > 0 && random.nextInt(16) == 0)
+                {
+                    MessageManager::callAsync(
+                        [this, state]
+                        {
+                            processor->setStateInformation(
+                                state.getData(), (int)state.getSize());
+                        });
+                }
+                break;
+            }
+            n++;
+
+            if (random.nextInt(4) == 0)
+                Thread::sleep(random.nextInt(3));
+            else
+                std::this_thread::yield();
+        }
+        calls += n;
+    }
+};
+
+std::unique_ptr<Run> run{};
+int exit_code{1};
+} // namespace
+
+namespace StressHarness
+{
+int getSeconds() noexcept
+{
+    auto s = std::getenv("NDI_AUDIO_IO_STRESS");
+    return s != nullptr ? jmax(0, std::atoi(s)) : 0;
+}
+
+const NDIlib_v5* getStandIn() noexcept
+{
+    static const NDIlib_v5 lib = makeStandIn();
+    return &lib;
+}
+
+void start()
+{
+    run = std::make_unique<Run>(getSeconds());
+    Thread::launch(
+        []
+        {
+            run->control();
+            MessageManager::callAsync(
+                []
+                {
+                    exit_code = run->finish();
+                    run.reset();
+                    MessageManager::getInstance()->stopDispatchLoop();
+                });
+        });
+}
+
+int getExitCode() noexcept
+{
+    return exit_code;
+}
+} // namespace StressHarness
+#endif
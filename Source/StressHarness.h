@@ -0,0 +1,35 @@
+#pragma once
+#include <JuceHeader.h>
+#include <Processing.NDI.Lib.h>
+
+// Concurrency stress build, console app ndi_audio_io_stress (tests/): one
+// thread plays host audio callback on a jittered schedule while others hammer
+// the text inputs, parameters, state and editor getters, all against an
+// in-process NDI loopback instead of the runtime. Build with
+// -DNDI_AUDIO_IO_STRESS=ON, add -DNDI_AUDIO_IO_TSAN=ON to run it under
+// ThreadSanitizer. Compiles to nothing otherwise.
+//
+// Runs for NDI_AUDIO_IO_STRESS seconds, prints worst-case and p99 audio
+// block time, late and silent blocks, then stops the dispatch loop. Exit
+// code is non-zero if no audio made it through the loopback.
+namespace StressHarness
+{
+#if NDI_AUDIO_IO_STRESS
+// seconds from NDI_AUDIO_IO_STRESS, 0 if not set
+int getSeconds() noexcept;
+
+// loopback runtime, senders are sources named "LOCAL (name)"
+const NDIlib_v5* getStandIn() noexcept;
+
+// message thread, starts the run, stops the dispatch loop when done
+void start();
+
+// after the dispatch loop returned
+int getExitCode() noexcept;
+#else
+inline int getSeconds() noexcept
+{
+    return 0;
+}
+#endif
+} // namespace StressHarness
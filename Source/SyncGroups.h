@@ -0,0 +1,239 @@
+#pragma once
+#include <JuceHeader.h>
+
+#include <array>
+#include <atomic>
+#include <mutex>
+
+// process-wide receiver sync groups, use through
+// SharedResourcePointer<SyncGroups>
+// every member reports how old the audio it plays is, measured against the
+// NDI frame timestamp on one shared clock. Members delay their output up to
+// the oldest member of their group, so all of them play content of the same
+// sender time together.
+class SyncGroups
+{
+  public:
+    static constexpr int max_members = 64;
+    static constexpr uint32 stale_ms = 1000;
+
+    SyncGroups()
+        : utc_base(Time::currentTimeMillis() * 10000),
+          ticks_base(Time::getHighResolutionTicks())
+    {
+    }
+
+    // message thread, returns member slot or -1 if all are taken
+    int join(const String &name)
+    {
+        std::scoped_lock lock{names_mutex};
+
+        auto group = names.indexOf(name);
+        if (group < 0)
+        {
+            names.add(name);
+            group = names.size() - 1;
+        }
+
+        for (auto i = 0; i < max_members; i++)
+        {
+            auto &m = members[(size_t)i];
+            auto expected = -1;
+            if (m.group.compare_exchange_strong(expected, group))
+            {
+                m.age = 0;
+                m.updated_ms = 0;
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    void leave(int slot)
+    {
+        if (slot >= 0 && slot < max_members)
+            members[(size_t)slot].group = -1;
+    }
+
+    // shared clock in NDI units (100 ns since epoch), same for all members
+    int64 now() const
+    {
+        auto ticks = Time::getHighResolutionTicks() - ticks_base;
+        return utc_base +
+               (int64)((double)ticks * 1.0e7 /
+                       (double)Time::getHighResolutionTicksPerSecond());
+    }
+
+    // callback time of the high resolution clock in ns (device or host time)
+    // on the shared clock
+    int64 fromHostTimeNs(uint64 ns) const
+    {
+        auto base_100ns =
+            (double)ticks_base * 1.0e7 /
+            (double)Time::getHighResolutionTicksPerSecond();
+        return utc_base + (int64)(ns / 100) - (int64)base_100ns;
+    }
+
+    // audio thread, own age in 100 ns units
+    void report(int slot, int64 age)
+    {
+        auto &m = members[(size_t)slot];
+        m.age.store(age, std::memory_order_relaxed);
+        m.updated_ms.store(Time::getMillisecondCounter(),
+                           std::memory_order_relaxed);
+    }
+
+    // audio thread, oldest age among live members of the slot's group
+    int64 getTargetAge(int slot) const
+    {
+        const auto &self = members[(size_t)slot];
+        auto group = self.group.load(std::memory_order_relaxed);
+        auto target = self.age.load(std::memory_order_relaxed);
+        auto now_ms = Time::getMillisecondCounter();
+
+        for (auto &&m : members)
+        {
+            if (m.group.load(std::memory_order_relaxed) != group ||
+                now_ms - m.updated_ms.load(std::memory_order_relaxed) >
+                    stale_ms)
+                continue;
+            target = jmax(target, m.age.load(std::memory_order_relaxed));
+        }
+        return target;
+    }
+
+  private:
+    struct Member
+    {
+        std::atomic<int> group{-1};
+        std::atomic<int64> age{0};
+        std::atomic<uint32> updated_ms{0};
+    };
+
+    const int64 utc_base;
+    const int64 ticks_base;
+
+    std::array<Member, max_members> members{};
+
+    std::mutex names_mutex;
+    StringArray names{};
+};
+
+// multichannel ring delay over storage carved by the caller, audio thread
+// a new delay crossfades from the old read position to the new one over
+// fade_ms. A jump in the input the ring can not bridge, e.g. samples dropped
+// from the frame-sync, fades out before it and in after it instead.
+class SyncDelay
+{
+  public:
+    static constexpr double fade_ms = 5.0;
+
+    // length must be a power of two
+    void setup(float *storage, int num_channels, int ring_length,
+               double sampleRate)
+    {
+        ring = storage;
+        channels = storage ? num_channels : 0;
+        length = ring_length;
+        mask = ring_length - 1;
+        write = 0;
+        fade = jlimit(1, ring_length / 2, (int)(fade_ms * sampleRate / 1000.0));
+        delay = 0;
+        from = 0;
+        faded = fade;
+        rise = fade;
+        jumped = false;
+    }
+
+    int getMaxDelay(int numSamples) const
+    {
+        return jmax(0, length - numSamples);
+    }
+
+    // delays first num_channels channels in place
+    template <typename T>
+    void process(T *const *channels_data, int num_channels, int numSamples,
+                 int target)
+    {
+        if (ring == nullptr)
+            return;
+
+        num_channels = jmin(num_channels, channels);
+        target = jlimit(0, getMaxDelay(numSamples), target);
+        from = jmin(from, getMaxDelay(numSamples));
+
+        // after a jump the new delay fades in with the input, otherwise it
+        // is taken once the previous crossfade is done
+        if (jumped)
+        {
+            delay = target;
+            faded = fade;
+            rise = 0;
+            jumped = false;
+        }
+        else if (target != delay && faded >= fade)
+        {
+            from = delay;
+            delay = target;
+            faded = 0;
+        }
+
+        for (auto c = 0; c < num_channels; c++)
+        {
+            auto r = ring + (size_t)c * (size_t)length;
+            auto p = channels_data[c];
+            for (auto j = 0; j < numSamples; j++)
+            {
+                r[(write + j) & mask] = static_cast<float>(p[j]);
+                auto x = r[(write + j - delay) & mask];
+                if (faded + j < fade)
+                {
+                    auto w = (float)(faded + j + 1) / (float)(fade + 1);
+                    auto y = r[(write + j - from) & mask];
+                    x = y + (x - y) * w;
+                }
+                if (rise + j < fade)
+                    x *= (float)(rise + j + 1) / (float)(fade + 1);
+                p[j] = static_cast<T>(x);
+            }
+        }
+        faded = jmin(fade, faded + numSamples);
+        rise = jmin(fade, rise + numSamples);
+        write = (write + numSamples) & mask;
+    }
+
+    // after process, the input jumps from the next block on
+    template <typename T>
+    void fadeOut(T *const *channels_data, int num_channels, int numSamples)
+    {
+        if (ring == nullptr)
+            return;
+
+        num_channels = jmin(num_channels, channels);
+        const auto n = jmin(fade, numSamples);
+        for (auto c = 0; c < num_channels; c++)
+        {
+            auto p = channels_data[c];
+            for (auto j = numSamples - n; j < numSamples; j++)
+                p[j] = static_cast<T>(
+                    p[j] * ((T)(numSamples - j) / (T)(n + 1)));
+        }
+        jumped = true;
+    }
+
+  private:
+    float *ring = nullptr;
+    int channels = 0;
+    int length = 0;
+    int mask = 0;
+    int write = 0;
+
+    // crossfade from the previous delay and fade-in after a jump, samples
+    // done of fade
+    int fade = 1;
+    int delay = 0;
+    int from = 0;
+    int faded = 1;
+    int rise = 1;
+    bool jumped = false;
+};
@@ -0,0 +1,193 @@
+#include "Trace.h"
+
+#if NDI_AUDIO_IO_TRACE
+#include "AudioThreadGuard.h"
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace
+{
+constexpr int max_threads = 32;
+constexpr std::uint32_t ring_length = 1u << 15; // events, power of two
+
+struct Event
+{
+    const char* category;
+    const char* name;
+    std::int64_t begin;
+    std::int64_t end;
+};
+
+enum RingState : int
+{
+    ring_free,
+    ring_owned,
+    ring_exited // events kept for the dump until another thread claims it
+};
+
+// zero initialised, pages are only touched by threads that record
+struct Ring
+{
+    std::atomic<int> state{ring_free};
+    std::atomic<std::uint32_t> written{0};
+    std::array<Event, ring_length> events{};
+};
+
+std::array<Ring, max_threads> rings{};
+std::atomic<bool> ever_enabled{false};
+const auto clock_base = std::chrono::steady_clock::now();
+
+// initial-exec keeps TLS access itself from calling malloc
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((tls_model("initial-exec")))
+#endif
+thread_local Ring* ring = nullptr;
+
+// hands the ring back when its thread exits
+struct Owner
+{
+    Ring* r = nullptr;
+
+    ~Owner()
+    {
+        if (r != nullptr)
+            r->state.store(ring_exited, std::memory_order_release);
+        ring = nullptr;
+    }
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((tls_model("initial-exec")))
+#endif
+thread_local Owner owner{};
+
+Ring* take(RingState from) noexcept
+{
+    for (auto&& r : rings)
+    {
+        auto expected = (int)from;
+        if (r.state.load(std::memory_order_relaxed) == from &&
+            r.state.compare_exchange_strong(expected, ring_owned))
+            return &r;
+    }
+    return nullptr;
+}
+
+// first event of a thread claims a free ring, else the oldest events of an
+// exited thread make room. Threads beyond max_threads alive at once are lost.
+Ring* claim() noexcept
+{
+    auto r = take(ring_free);
+    if (r == nullptr)
+    {
+        r = take(ring_exited);
+        if (r == nullptr)
+            return nullptr;
+        r->written.store(0, std::memory_order_release);
+    }
+
+    // registering the exit hook may allocate once per thread
+    AudioThreadGuard::Suspend hook{};
+    owner.r = r;
+    return ring = r;
+}
+
+const char* defaultPath()
+{
+    if (auto p = std::getenv("NDI_AUDIO_IO_TRACE_FILE"))
+        return p;
+
+    static std::string path{};
+    const char* tmp = std::getenv("TMPDIR");
+    if (tmp == nullptr)
+        tmp = std::getenv("TEMP");
+    path = std::string(tmp != nullptr ? tmp : ".") + "/ndi_audio_io_trace.json";
+    return path.c_str();
+}
+
+// starts recording for the process if asked to, dumps at exit
+struct Session
+{
+    Session()
+    {
+        if (std::getenv("NDI_AUDIO_IO_TRACE_FILE") != nullptr)
+            Trace::setEnabled(true);
+    }
+
+    ~Session()
+    {
+        if (ever_enabled.load())
+            Trace::dump();
+    }
+} session{};
+} // namespace
+
+namespace Trace
+{
+std::atomic<bool> enabled{false};
+
+std::int64_t now() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - clock_base)
+        .count();
+}
+
+void record(const char* category, const char* name, std::int64_t begin,
+            std::int64_t end) noexcept
+{
+    auto r = ring != nullptr ? ring : claim();
+    if (r == nullptr)
+        return;
+
+    // single writer, dump reads up to the published count
+    auto n = r->written.load(std::memory_order_relaxed);
+    r->events[n & (ring_length - 1)] = {category, name, begin, end};
+    r->written.store(n + 1, std::memory_order_release);
+}
+
+void setEnabled(bool on) noexcept
+{
+    if (on)
+        ever_enabled = true;
+    enabled = on;
+}
+
+bool dump(const char* path)
+{
+    auto f = std::fopen(path != nullptr ? path : defaultPath(), "w");
+    if (f == nullptr)
+        return false;
+
+    std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", f);
+    auto first = true;
+    for (auto t = 0; t < max_threads; t++)
+    {
+        auto& r = rings[(size_t)t];
+        if (r.state.load(std::memory_order_acquire) == ring_free)
+            continue;
+
+        auto n = r.written.load(std::memory_order_acquire);
+        auto i = n > ring_length ? n - ring_length : 0;
+        for (; i < n; i++)
+        {
+            const auto& e = r.events[i & (ring_length - 1)];
+            std::fprintf(f,
+                         "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+                         "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                         first ? "" : ",\n", e.name, e.category,
+                         (double)e.begin / 1000.0,
+                         (double)(e.end - e.begin) / 1000.0, t + 1);
+            first = false;
+        }
+    }
+    std::fputs("\n]}\n", f);
+
+    return std::fclose(f) == 0;
+}
+} // namespace Trace
+#endif
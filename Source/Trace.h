@@ -0,0 +1,112 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Profiling build that records scoped timing events of the audio, NDI, worker
+// and GUI threads into per-thread buffers and writes them as Chrome trace JSON
+// (chrome://tracing, ui.perfetto.dev). Build with -DNDI_AUDIO_IO_TRACE=ON.
+// Compiles to nothing otherwise.
+//
+// Recording starts at load when NDI_AUDIO_IO_TRACE_FILE is set, or with
+// "trace on" on the control endpoint. While off a scope is one relaxed load.
+// Events are written at exit to NDI_AUDIO_IO_TRACE_FILE, or
+// ndi_audio_io_trace.json in the temp directory, and on "trace dump" there or
+// to the named file in the temp directory.
+//
+// Each thread writes its own ring of the latest events without locks, a dump
+// while recording may show a few torn events at the ring boundary. Rings of
+// exited threads are kept for the dump until a new thread needs one.
+namespace Trace
+{
+#if NDI_AUDIO_IO_TRACE
+extern std::atomic<bool> enabled;
+
+std::int64_t now() noexcept;
+void record(const char* category, const char* name, std::int64_t begin,
+            std::int64_t end) noexcept;
+
+void setEnabled(bool on) noexcept;
+
+// returns false if file can not be written, nullptr for default path
+bool dump(const char* path = nullptr);
+
+// times its own lifetime, name and category must be string literals
+class Scope
+{
+  public:
+    Scope(const char* category_, const char* name_) noexcept
+        : category(category_), name(name_),
+          begin(enabled.load(std::memory_order_relaxed) ? now() : -1)
+    {
+    }
+
+    ~Scope()
+    {
+        if (begin >= 0)
+            record(category, name, begin, now());
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    const char* category;
+    const char* name;
+    std::int64_t begin;
+};
+#else
+inline void setEnabled(bool) noexcept
+{
+}
+
+inline bool dump(const char* = nullptr)
+{
+    return false;
+}
+
+struct Scope
+{
+    Scope(const char*, const char*) noexcept
+    {
+    }
+};
+#endif
+
+// mutex whose lock waits show up as events, e.g. Mutex<std::mutex>
+template <typename M>
+class Mutex : public M
+{
+  public:
+    explicit Mutex(const char* name_) noexcept : name(name_)
+    {
+    }
+
+    void lock()
+    {
+        Scope trace{"lock", name};
+        M::lock();
+    }
+
+  private:
+    const char* name;
+};
+
+// same for locks with enter/exit, e.g. Lock<juce::SpinLock>
+template <typename L>
+class Lock : public L
+{
+  public:
+    explicit Lock(const char* name_) noexcept : name(name_)
+    {
+    }
+
+    void enter() const noexcept
+    {
+        Scope trace{"lock", name};
+        L::enter();
+    }
+
+  private:
+    const char* name;
+};
+} // namespace Trace
@@ -0,0 +1,95 @@
+// audio thread guard, see Source/AudioThreadGuard.h. Built with the guard on
+// whatever the option says, reports go to a counting handler instead of
+// abort. Exits non-zero on the first failed check.
+#include "AudioThreadGuard.h"
+
+#include <cstdio>
+
+namespace
+{
+int failures = 0;
+int reports = 0;
+
+// kept so the compiler can not drop the allocation
+int *volatile sink = nullptr;
+
+void count(const char *) noexcept
+{
+    reports++;
+}
+
+void expect(bool ok, const char *what)
+{
+    if (ok)
+        return;
+    std::printf("failed: %s\n", what);
+    failures++;
+}
+
+void allocate()
+{
+    sink = new int{1};
+}
+
+void release()
+{
+    delete sink;
+    sink = nullptr;
+}
+
+void allocationUnderScopeIsReported()
+{
+    reports = 0;
+    {
+        AudioThreadGuard::Scope scope{};
+        allocate();
+    }
+    release();
+    expect(reports > 0, "new under Scope reported");
+}
+
+void allocationUnderSuspendIsNot()
+{
+    reports = 0;
+    {
+        AudioThreadGuard::Scope scope{};
+        AudioThreadGuard::Suspend suspend{};
+        allocate();
+        release();
+    }
+    expect(reports == 0, "new under Suspend not reported");
+}
+
+void allocationOutsideScopeIsNot()
+{
+    reports = 0;
+    allocate();
+    release();
+    expect(reports == 0, "new outside Scope not reported");
+}
+
+void mutexUnderScopeIsReported()
+{
+    AudioThreadGuard::Mutex m{};
+    reports = 0;
+    {
+        AudioThreadGuard::Scope scope{};
+        m.lock();
+        m.unlock();
+    }
+    expect(reports == 1, "mutex lock under Scope reported");
+}
+} // namespace
+
+int main()
+{
+    AudioThreadGuard::setHandler(count);
+    allocationUnderScopeIsReported();
+    allocationUnderSuspendIsNot();
+    allocationOutsideScopeIsNot();
+    mutexUnderScopeIsReported();
+    AudioThreadGuard::setHandler(nullptr);
+
+    std::printf("%s\n", failures == 0 ? "passed" : "failed");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+// codec=lossless receive FIFO, see Source/LosslessStream.h. Exits non-zero
+// on the first failed check.
+#include <JuceHeader.h>
+
+#include "LosslessStream.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+constexpr int channels = 2;
+constexpr int packet_samples = 256;
+constexpr int sample_rate = 48000;
+
+struct NoLock
+{
+    void enter() {}
+    void exit() {}
+};
+
+int failures = 0;
+
+void expect(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        std::printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+// 24 bit ramp, channel c starts at c
+std::vector<char> makePacket(int64 first)
+{
+    std::vector<float> audio((size_t)channels * packet_samples);
+    for (auto c = 0; c < channels; c++)
+        for (auto i = 0; i < packet_samples; i++)
+            audio[(size_t)(c * packet_samples + i)] =
+                (float)((c + first + i) % 4096) / 8388608.0f;
+
+    const auto stride = LosslessCodec::maxChannelBytes(packet_samples);
+    std::vector<uint8> coded((size_t)channels * stride);
+    std::vector<uint8> packet(
+        LosslessCodec::maxPacketBytes(channels, packet_samples));
+    std::vector<int32> q(packet_samples);
+
+    LosslessCodec::writeHeader(packet.data(), {channels, packet_samples,
+                                               sample_rate, first});
+    auto size = LosslessCodec::headerBytes(channels);
+    for (auto c = 0; c < channels; c++)
+    {
+        const auto n = LosslessCodec::encodeChannel(
+            audio.data() + (size_t)c * packet_samples, packet_samples,
+            q.data(), coded.data() + (size_t)c * stride);
+        LosslessCodec::setChannelSize(packet.data(), c, n);
+        std::memcpy(packet.data() + size, coded.data() + (size_t)c * stride,
+                    n);
+        size += n;
+    }
+
+    std::vector<char> xml(LosslessCodec::maxXmlBytes(size));
+    LosslessCodec::format(packet.data(), size, xml.data());
+    return xml;
+}
+
+// the jitter controller pulls a sample more than the block
+void readsOneMoreThanMaxBlock()
+{
+    constexpr auto max_block = 128;
+    LosslessReceiver receiver{};
+    NoLock lock{};
+
+    for (auto k = 0; k < 8; k++)
+        expect(receiver.receive(makePacket((int64)k * packet_samples).data(),
+                                max_block, lock),
+               "packet accepted");
+    expect(receiver.isActive(sample_rate), "stream active");
+
+    auto expected = int64{0};
+    for (auto b = 0; b < 4; b++)
+    {
+        const auto &frame = receiver.read(max_block + 1);
+        expect(frame.no_samples == max_block + 1, "frame holds the pull");
+        expect(frame.channel_stride_in_bytes ==
+                   frame.no_samples * (int)sizeof(float),
+               "stride matches samples");
+
+        const auto last = frame.p_data + (size_t)(channels - 1) *
+                                             (size_t)frame.no_samples;
+        expect(last[frame.no_samples - 1] ==
+                   (float)((channels - 1 + expected + frame.no_samples - 1) %
+                           4096) /
+                       8388608.0f,
+               "last sample of last channel decoded");
+        expected += frame.no_samples;
+    }
+
+    // more than the stream was sized for is cut, never read past the block
+    const auto &frame = receiver.read(4 * max_block);
+    expect(frame.no_samples == max_block + 1, "oversized read clamped");
+}
+} // namespace
+
+int main()
+{
+    readsOneMoreThanMaxBlock();
+    std::printf("%s\n", failures == 0 ? "passed" : "failed");
+    return failures == 0 ? 0 : 1;
+}
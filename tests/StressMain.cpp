@@ -0,0 +1,22 @@
+// headless stress run, see Source/StressHarness.h. NDI_AUDIO_IO_STRESS holds
+// the duration in seconds, ctest sets it.
+#include <JuceHeader.h>
+
+#include "StressHarness.h"
+
+#include <cstdio>
+
+int main()
+{
+    if (StressHarness::getSeconds() <= 0)
+    {
+        std::printf("set NDI_AUDIO_IO_STRESS to the run time in seconds\n");
+        return 2;
+    }
+
+    // message thread for the restore queue and session loads
+    juce::ScopedJuceInitialiser_GUI juce_init{};
+    StressHarness::start();
+    juce::MessageManager::getInstance()->runDispatchLoop();
+    return StressHarness::getExitCode();
+}
@@ -0,0 +1,214 @@
+// Prints the shared memory counters of running plugin instances for
+// monitoring agents, layout in Source/MetricsLayout.h.
+//
+//   ndi_audio_io_metrics [--prometheus] [--clean] [segment...]
+//
+// segment is a name like /ndi_audio_io.1234.1. Without one every segment in
+// /dev/shm is read (Linux; macOS can not list them, give names there).
+// --prometheus prints text exposition format for a scraper, --clean removes
+// segments left behind by processes that are gone.
+#include "MetricsLayout.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+struct Instance
+{
+    std::string segment;
+    std::uint32_t pid = 0;
+    std::uint32_t instance = 0;
+    MetricsLayout::Snapshot snapshot{};
+};
+
+std::vector<std::string> listSegments()
+{
+    std::vector<std::string> names{};
+    const std::string prefix = MetricsLayout::name_prefix + 1;
+
+    if (auto dir = opendir("/dev/shm"))
+    {
+        while (auto entry = readdir(dir))
+        {
+            if (std::strncmp(entry->d_name, prefix.c_str(), prefix.size()) ==
+                0)
+                names.push_back(std::string("/") + entry->d_name);
+        }
+        closedir(dir);
+    }
+    return names;
+}
+
+bool isRunning(std::uint32_t pid)
+{
+    return kill((pid_t)pid, 0) == 0 || errno != ESRCH;
+}
+
+// false if segment is missing, not ours or torn by a crashed writer
+bool readSegment(const std::string &name, Instance &dst)
+{
+    auto fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+
+    struct stat st{};
+    const auto header = offsetof(MetricsLayout::Segment, values);
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < header)
+    {
+        close(fd);
+        return false;
+    }
+
+    const auto size = (size_t)st.st_size;
+    auto p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+
+    const auto &s = *static_cast<const MetricsLayout::Segment *>(p);
+    const auto ok =
+        s.magic == MetricsLayout::magic &&
+        s.version == MetricsLayout::version &&
+        header + s.value_count * sizeof(std::int64_t) <= size &&
+        MetricsLayout::read(s, dst.snapshot);
+
+    dst.segment = name;
+    if (s.magic == MetricsLayout::magic)
+    {
+        dst.pid = s.pid;
+        dst.instance = s.instance;
+    }
+    munmap(p, size);
+    return ok;
+}
+
+std::string escapeLabel(const char *s)
+{
+    std::string out{};
+    for (; *s != 0; s++)
+    {
+        if (*s == '\\' || *s == '"')
+            out += '\\';
+        if (*s == '\n')
+        {
+            out += "\\n";
+            continue;
+        }
+        out += *s;
+    }
+    return out;
+}
+
+void printText(const Instance &i)
+{
+    const auto &v = i.snapshot.values;
+    const auto age_ms = (std::int64_t)std::time(nullptr) * 1000 -
+                        v[MetricsLayout::updated_ms];
+
+    std::printf("%s pid %u instance %u, updated %.1f s ago\n",
+                i.segment.c_str(), i.pid, i.instance, (double)age_ms / 1000.0);
+    std::printf("  send \"%s\" recv \"%s\"\n", i.snapshot.send_name,
+                i.snapshot.recv_name);
+    for (auto k = 1; k < i.snapshot.value_count; k++)
+    {
+        std::printf("  %-22s %lld", MetricsLayout::value_names[k],
+                    (long long)v[k]);
+        if (k == MetricsLayout::recv_drift_ppb)
+            std::printf(" (%.3f ppm)", (double)v[k] / 1000.0);
+        std::printf("\n");
+    }
+}
+
+void printPrometheus(const std::vector<Instance> &instances)
+{
+    for (auto k = 0; k < MetricsLayout::num_values; k++)
+    {
+        std::printf("# TYPE ndi_audio_io_%s gauge\n",
+                    MetricsLayout::value_names[k]);
+        for (auto &&i : instances)
+        {
+            if (k >= i.snapshot.value_count)
+                continue;
+
+            std::printf("ndi_audio_io_%s{pid=\"%u\",instance=\"%u\","
+                        "send=\"%s\",recv=\"%s\"} %lld\n",
+                        MetricsLayout::value_names[k], i.pid, i.instance,
+                        escapeLabel(i.snapshot.send_name).c_str(),
+                        escapeLabel(i.snapshot.recv_name).c_str(),
+                        (long long)i.snapshot.values[k]);
+        }
+    }
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    auto prometheus = false;
+    auto clean = false;
+    std::vector<std::string> names{};
+
+    for (auto a = 1; a < argc; a++)
+    {
+        const std::string arg = argv[a];
+        if (arg == "--prometheus")
+            prometheus = true;
+        else if (arg == "--clean")
+            clean = true;
+        else if (!arg.empty() && arg[0] != '-')
+            names.push_back(arg[0] == '/' ? arg : "/" + arg);
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--prometheus] [--clean] "
+                                 "[segment...]\n",
+                         argv[0]);
+            return 2;
+        }
+    }
+
+    if (names.empty())
+        names = listSegments();
+
+    std::vector<Instance> instances{};
+    for (auto &&name : names)
+    {
+        Instance i{};
+        const auto ok = readSegment(name, i);
+
+        // crashed or killed writer, nobody else unlinks it
+        if (i.pid != 0 && !isRunning(i.pid))
+        {
+            if (clean && shm_unlink(name.c_str()) == 0)
+                std::fprintf(stderr, "removed %s\n", name.c_str());
+            continue;
+        }
+
+        if (ok)
+            instances.push_back(i);
+        else if (!clean)
+            std::fprintf(stderr, "%s: can not read\n", name.c_str());
+    }
+
+    if (clean)
+        return 0;
+
+    if (prometheus)
+        printPrometheus(instances);
+    else
+        for (auto &&i : instances)
+            printText(i);
+
+    return 0;
+}